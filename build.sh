@@ -48,7 +48,11 @@ add_bg gcc -c src/internal.c     ${CFLAGS} ${CFG} -o src/internal.o
 add_bg gcc -c src/stb_image.c    ${CFLAGS} ${CFG} -o src/stb_image.o
 add_bg gcc -c src/array.c        ${CFLAGS} ${CFG} -o src/array.o
 add_bg gcc -c src/font.c         ${CFLAGS} ${CFG} -o src/font.o
+add_bg gcc -c src/glyph_cache.c  ${CFLAGS} ${CFG} -o src/glyph_cache.o
+add_bg gcc -c src/batch.c        ${CFLAGS} ${CFG} -o src/batch.o
 add_bg gcc -c src/presentation.c ${CFLAGS} ${CFG} -o src/presentation.o
+add_bg gcc -c src/slide_cache.c  ${CFLAGS} ${CFG} -o src/slide_cache.o
+add_bg gcc -c src/thumbnails.c   ${CFLAGS} ${CFG} -o src/thumbnails.o
 add_bg gcc -c src/pdf.c          ${CFLAGS} ${CFG} -o src/pdf.o
 add_bg gcc -c src/slide.c        ${CFLAGS} ${CFG} -o src/slide.o
 
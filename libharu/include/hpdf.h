@@ -297,6 +297,13 @@ HPDF_LoadTTFontFromFile (HPDF_Doc     pdf,
                          HPDF_BOOL    embedding);
 
 
+HPDF_EXPORT(const char*)
+HPDF_LoadTTFontFromMem (HPDF_Doc          pdf,
+                        const HPDF_BYTE  *buffer,
+                        HPDF_UINT         size,
+                        HPDF_BOOL         embedding);
+
+
 HPDF_EXPORT(const char*)
 HPDF_LoadTTFontFromFile2 (HPDF_Doc     pdf,
                           const char  *file_name,
@@ -1522,6 +1522,42 @@ HPDF_LoadTTFontFromFile (HPDF_Doc         pdf,
 }
 
 
+HPDF_EXPORT(const char*)
+HPDF_LoadTTFontFromMem (HPDF_Doc         pdf,
+                        const HPDF_BYTE *buffer,
+                        HPDF_UINT        size,
+                        HPDF_BOOL        embedding)
+{
+    HPDF_Stream font_data;
+    const char *ret;
+
+    HPDF_PTRACE ((" HPDF_LoadTTFontFromMem\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    /* create memory stream */
+    font_data = HPDF_MemStream_New (pdf->mmgr, size);
+
+    if (!HPDF_Stream_Validate (font_data)) {
+        HPDF_RaiseError (&pdf->error, HPDF_INVALID_STREAM, 0);
+        return NULL;
+    }
+
+    if (HPDF_Stream_Write (font_data, buffer, size) != HPDF_OK) {
+        HPDF_Stream_Free (font_data);
+        return NULL;
+    }
+
+    ret = LoadTTFontFromStream (pdf, font_data, embedding, NULL);
+
+    if (!ret)
+        HPDF_CheckError (&pdf->error);
+
+    return ret;
+}
+
+
 static const char*
 LoadTTFontFromStream (HPDF_Doc         pdf,
                       HPDF_Stream      font_data,
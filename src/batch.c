@@ -0,0 +1,139 @@
+#include "batch.h"
+
+static array_t buckets;
+static int     n_buckets;
+static int     last_bucket;
+static u32     draw_calls;
+
+static batch_bucket_t *get_bucket(SDL_Texture *texture) {
+    batch_bucket_t *bucket;
+    batch_bucket_t  new_bucket;
+    int             i;
+    int             w, h;
+
+    if (buckets.elem_size == 0) {
+        buckets = array_make(batch_bucket_t);
+    }
+
+    if (last_bucket < n_buckets) {
+        bucket = array_item(buckets, last_bucket);
+        if (bucket->texture == texture) { return bucket; }
+    }
+
+    for (i = 0; i < n_buckets; i += 1) {
+        bucket = array_item(buckets, i);
+        if (bucket->texture == texture) {
+            last_bucket = i;
+            return bucket;
+        }
+    }
+
+    /* Buckets past n_buckets keep their buffers around for reuse. */
+    if (n_buckets == array_len(buckets)) {
+        memset(&new_bucket, 0, sizeof(new_bucket));
+        new_bucket.verts   = array_make(SDL_Vertex);
+        new_bucket.indices = array_make(int);
+        array_push(buckets, new_bucket);
+    }
+
+    bucket = array_item(buckets, n_buckets);
+
+    SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+
+    bucket->texture = texture;
+    bucket->tex_w   = w;
+    bucket->tex_h   = h;
+
+    last_bucket  = n_buckets;
+    n_buckets   += 1;
+
+    return bucket;
+}
+
+void batch_glyph(SDL_Renderer *sdl_ren, font_entry_t *entry, int x, int y, u32 r, u32 g, u32 b) {
+    batch_bucket_t *bucket;
+    SDL_Vertex      v[4];
+    int             idx[6];
+    int             base;
+    float           x0, y0, x1, y1;
+    float           u0, v0, u1, v1;
+    int             i;
+
+    if (entry->w == 0 || entry->h == 0) { return; }
+
+    if (unlikely(entry->texture == NULL)
+    &&  !font_restore_glyph(entry, sdl_ren)) {
+        return;
+    }
+
+    entry->last_used = font_frame;
+
+    bucket = get_bucket(entry->texture);
+
+    x0 = x + (int)entry->adjust_x;
+    y0 = y - (int)entry->adjust_y;
+    x1 = x0 + entry->w;
+    y1 = y0 + entry->h;
+
+    u0 = entry->x / bucket->tex_w;
+    v0 = entry->y / bucket->tex_h;
+    u1 = (entry->x + entry->src_w) / bucket->tex_w;
+    v1 = (entry->y + entry->src_h) / bucket->tex_h;
+
+    v[0].position.x = x0; v[0].position.y = y0; v[0].tex_coord.x = u0; v[0].tex_coord.y = v0;
+    v[1].position.x = x1; v[1].position.y = y0; v[1].tex_coord.x = u1; v[1].tex_coord.y = v0;
+    v[2].position.x = x1; v[2].position.y = y1; v[2].tex_coord.x = u1; v[2].tex_coord.y = v1;
+    v[3].position.x = x0; v[3].position.y = y1; v[3].tex_coord.x = u0; v[3].tex_coord.y = v1;
+
+    for (i = 0; i < 4; i += 1) {
+        v[i].color.r = r;
+        v[i].color.g = g;
+        v[i].color.b = b;
+        v[i].color.a = 255;
+    }
+
+    base   = array_len(bucket->verts);
+    idx[0] = base + 0; idx[1] = base + 1; idx[2] = base + 2;
+    idx[3] = base + 0; idx[4] = base + 2; idx[5] = base + 3;
+
+    array_push_n(bucket->verts,   v,   4);
+    array_push_n(bucket->indices, idx, 6);
+}
+
+void batch_flush(SDL_Renderer *sdl_ren) {
+    batch_bucket_t *bucket;
+    int             i;
+
+    for (i = 0; i < n_buckets; i += 1) {
+        bucket = array_item(buckets, i);
+
+        if (array_len(bucket->indices)) {
+            SDL_RenderGeometry(sdl_ren, bucket->texture,
+                               array_data(bucket->verts),   array_len(bucket->verts),
+                               array_data(bucket->indices), array_len(bucket->indices));
+            draw_calls += 1;
+        }
+
+        bucket->texture = NULL;
+        array_clear(bucket->verts);
+        array_clear(bucket->indices);
+    }
+
+    n_buckets   = 0;
+    last_bucket = 0;
+}
+
+void batch_fill_rect(SDL_Renderer *sdl_ren, const SDL_Rect *rect) {
+    batch_flush(sdl_ren);
+    SDL_RenderFillRect(sdl_ren, rect);
+    draw_calls += 1;
+}
+
+void batch_copy(SDL_Renderer *sdl_ren, SDL_Texture *texture, const SDL_Rect *srect, const SDL_Rect *drect) {
+    batch_flush(sdl_ren);
+    SDL_RenderCopy(sdl_ren, texture, srect, drect);
+    draw_calls += 1;
+}
+
+void batch_reset_draw_calls(void) { draw_calls = 0;    }
+u32  batch_get_draw_calls(void)   { return draw_calls; }
@@ -0,0 +1,36 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include "internal.h"
+#include "array.h"
+#include "font.h"
+
+/*
+ * Glyph batcher.
+ *
+ * Glyph quads are collected per texture and submitted with one
+ * SDL_RenderGeometry() call per texture when the batch is flushed.
+ * Text color is carried by the vertices, so glyph textures stay
+ * white and are never modified while drawing.
+ *
+ * Anything that is not a glyph (rectangles, images) goes through
+ * here as well so that the batch is flushed first and the drawing
+ * order is preserved.
+ */
+
+typedef struct {
+    SDL_Texture *texture;
+    float        tex_w, tex_h;
+    array_t      verts;
+    array_t      indices;
+} batch_bucket_t;
+
+void batch_glyph(SDL_Renderer *sdl_ren, font_entry_t *entry, int x, int y, u32 r, u32 g, u32 b);
+void batch_flush(SDL_Renderer *sdl_ren);
+void batch_fill_rect(SDL_Renderer *sdl_ren, const SDL_Rect *rect);
+void batch_copy(SDL_Renderer *sdl_ren, SDL_Texture *texture, const SDL_Rect *srect, const SDL_Rect *drect);
+
+void batch_reset_draw_calls(void);
+u32  batch_get_draw_calls(void);
+
+#endif
@@ -1,7 +1,32 @@
 #include "font.h"
 
-font_map_t font_map;
-FT_Library ft_lib;
+#include FT_OUTLINE_H
+#include FT_SIZES_H
+
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+font_map_t        font_map;
+font_master_map_t font_master_map;
+font_file_map_t   font_file_map;
+FT_Library        ft_lib;
+int               font_shared_atlas;
+float             font_raster_scale = 1.0;
+u64               font_atlas_budget = FONT_ATLAS_DEFAULT_BUDGET_MB * 1024ULL * 1024ULL;
+u32               font_frame;
+
+/* See FONT_ATLAS_DEFAULT_BUDGET_MB. */
+static u64 atlas_bytes;
+static u32 atlas_evictions, evicted_glyphs, restored_glyphs;
+
+/* See font_preload(). */
+static pthread_mutex_t preload_mtx  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  preload_cond = PTHREAD_COND_INITIALIZER;
+static array_t         free_libs;
+static array_t         preloads;
+static int             n_preloads_running;
 
 int init_font(void) {
     int err;
@@ -12,7 +37,11 @@ int init_font(void) {
     setlocale(LC_ALL, "en_US.utf8");
 #endif
 
-    font_map = tree_make_c(font_name_t, font_cache_t, strcmp);
+    font_map        = tree_make_c(font_name_t, font_cache_t, strcmp);
+    font_master_map = tree_make_c(font_name_t, font_master_t, strcmp);
+    font_file_map   = tree_make_c(font_name_t, font_file_t, strcmp);
+    free_libs       = array_make(FT_Library);
+    preloads        = array_make(font_preload_t*);
 
     err = FT_Init_FreeType(&ft_lib);
 
@@ -24,31 +53,87 @@ int init_font(void) {
     return 1;
 }
 
-font_cache_t *get_or_load_font(const char *name, u32 size, SDL_Renderer *sdl_ren) {
-    char          lookup_buff[256];
-    font_map_it   it;
-    int           err;
-    font_cache_t  cache;
-    FT_Bitmap     b;
-    FT_GlyphSlot  g;
-    u32          *pixels, max_w, max_h, num_pixels, p, r, c, max_glyph_pixels;
-    int           i, j, k, l, m, x, y;
-    SDL_Rect      rect;
+static u32 get_line_height(font_cache_t *font);
+static void init_shared_font(font_cache_t *font);
 
+/*
+ * Fonts can be loaded on several threads at once (see font_preload()),
+ * so font_file_map is only touched with font_file_mtx held. A file's
+ * face is shared by all of its sizes, so anything that uses it while
+ * fonts may be loading holds the file's own mutex. That way, different
+ * files still load in parallel.
+ */
+static pthread_mutex_t font_file_mtx = PTHREAD_MUTEX_INITIALIZER;
 
-    snprintf(lookup_buff, sizeof(lookup_buff), "%s:%u", name, size);
+static font_file_t *get_font_file(const char *path) {
+    font_file_map_it  it;
+    font_file_t       file;
 
-    it = tree_lookup(font_map, lookup_buff);
+    pthread_mutex_lock(&font_file_mtx);
 
-    if (tree_it_good(it)) {
-        return &tree_it_val(it);
+    it = tree_lookup(font_file_map, (char*)path);
+
+    if (!tree_it_good(it)) {
+        memset(&file, 0, sizeof(file));
+        file.path = strdup(path);
+
+        /* The mutex is initialised where it lives: copies of one aren't valid. */
+        it = tree_insert(font_file_map, file.path, file);
+        pthread_mutex_init(&tree_it_val(it).mtx, NULL);
+    }
+
+    pthread_mutex_unlock(&font_file_mtx);
+
+    return &tree_it_val(it);
+}
+
+/*
+ * The file is mapped once and everything that reads it (FreeType and
+ * the PDF export) reads the mapping. It is never unmapped since faces
+ * keep pointing into it.
+ * Must be called with file->mtx held.
+ */
+static void map_font_file(font_file_t *file) {
+    int         fd;
+    struct stat st;
+    void       *data;
+
+    if (file->data != NULL) { return; }
+
+    fd = open(file->path, O_RDONLY);
+    if (fd < 0) {
+        ERR("font load error\n");
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        ERR("font load error\n");
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        ERR("font load error\n");
     }
 
-    cache.path                = strdup(name);
-    cache.size                = size;
-    cache.non_ascii_entry_map = tree_make(char_code_t, font_entry_t);
+    file->data = data;
+    file->size = st.st_size;
+}
+
+/* Must be called with file->mtx held. */
+static void open_font_file(font_file_t *file, FT_Library lib) {
+    int      err;
+    FT_Face  face;
+    FT_BBox  cbox;
+    i32      heights[256];
+    int      c, k, best;
 
-    err = FT_New_Face(ft_lib, name, 0, &cache.ft_face);
+    if (file->ft_face != NULL) { return; }
+
+    map_font_file(file);
+
+    err = FT_New_Memory_Face(lib, file->data, file->size, 0, &face);
 
     if (err == FT_Err_Unknown_File_Format) {
         ERR("font not a font error\n");
@@ -56,200 +141,1603 @@ font_cache_t *get_or_load_font(const char *name, u32 size, SDL_Renderer *sdl_ren
         ERR("font load error\n");
     }
 
+    /* Unscaled outlines don't depend on the size, so this happens once per file. */
+    for (c = 0; c < 256; c += 1) {
+        heights[c] = 0;
+
+        if (FT_Load_Char(face, c, FT_LOAD_NO_SCALE) == 0
+        &&  face->glyph->format == FT_GLYPH_FORMAT_OUTLINE) {
+
+            FT_Outline_Get_CBox(&face->glyph->outline, &cbox);
+            heights[c] = cbox.yMax - cbox.yMin;
+        }
+    }
+
+    for (k = 0; k < FONT_LINE_HEIGHT_CANDIDATES; k += 1) {
+        best = 0;
+        for (c = 1; c < 256; c += 1) {
+            if (heights[c] > heights[best]) { best = c; }
+        }
+
+        file->tallest[k] = best;
+        heights[best]    = -1;
+    }
+
+    file->ft_face = face;
+}
+
+/* The contents of the font file at path, which is only read once per run. */
+u64 get_font_file_data(const char *path, const unsigned char **data) {
+    font_file_t *file;
+
+    file = get_font_file(path);
+
+    pthread_mutex_lock(&file->mtx);
+    map_font_file(file);
+    pthread_mutex_unlock(&file->mtx);
+
+    *data = file->data;
+
+    return file->size;
+}
+
+/* Every size of a file shares its face, so the size has to be made current first. */
+static FT_Face font_face(font_cache_t *font) {
+    FT_Activate_Size(font->ft_size);
+    return font->ft_face;
+}
+
+static void load_font(font_cache_t *cache, FT_Library lib, const char *name, u32 size) {
+    int err;
+
+    memset(cache, 0, sizeof(*cache));
+
+    cache->path                = strdup(name);
+    cache->size                = size;
+    cache->glyph_pages         = array_make(font_glyph_page_t*);
+    cache->fallbacks           = array_make(char*);
+    cache->atlas_pages         = array_make(font_atlas_page_t);
+    cache->file                = get_font_file(name);
+
+    pthread_mutex_lock(&cache->file->mtx);
+
+    open_font_file(cache->file, lib);
+
+    cache->ft_face = cache->file->ft_face;
+
+    if (FT_New_Size(cache->ft_face, &cache->ft_size)) {
+        ERR("font size err\n");
+    }
+
     err = FT_Set_Char_Size(
-                cache.ft_face, /* handle to face object           */
-                0,             /* char_width in 1/64th of points  */
-                size*64,       /* char_height in 1/64th of points */
-                300,           /* horizontal device resolution    */
-                300 );         /* vertical device resolution      */
+                font_face(cache), /* handle to face object           */
+                0,                /* char_width in 1/64th of points  */
+                size*64,          /* char_height in 1/64th of points */
+                300,              /* horizontal device resolution    */
+                300 );            /* vertical device resolution      */
 
     if (err) {
         ERR("font size err\n");
     }
 
-    /* Find out how many pixels to allocate. */
-    max_w = max_h = 0;
-    for (i = 0; i < 256; i += 1) {
-        FT_Load_Char(cache.ft_face, i, FT_LOAD_RENDER);
-        g = cache.ft_face->glyph;
-        b = g->bitmap;
+    cache->disk        = glyph_cache_open(name, size * 64, 300);
+    cache->has_kerning = FT_HAS_KERNING(cache->ft_face);
+
+    /* Glyphs, ASCII included, are rasterised when they're first used. */
+    if (cache->disk != NULL && cache->disk->line_height) {
+        cache->line_height = cache->disk->line_height;
+    } else {
+        cache->line_height = get_line_height(cache);
 
-        if (b.width > max_w) { max_w = b.width; }
-        if (b.rows > max_h)  { max_h = b.rows;  }
+        if (cache->disk != NULL) {
+            glyph_cache_set_line_height(cache->disk, cache->line_height);
+        }
     }
-    max_glyph_pixels = max_w * max_h;
-    num_pixels       = 256 * max_glyph_pixels;
 
-    rect.x = rect.y = 0;
-    rect.w = 16 * max_w;
-    rect.h = 16 * max_h;
+    pthread_mutex_unlock(&cache->file->mtx);
+}
 
-    cache.line_height = max_h;
+/* Sizes the font's raster FT_Size for font_raster_scale. */
+static void set_raster_size(font_cache_t *font) {
+    u32 dpi;
 
-    /* Create the pixel buffer and texture. */
-    if (sdl_ren != NULL) {
-        pixels = (u32*)malloc(sizeof(u32) * num_pixels);
-        memset(pixels, 0, sizeof(u32) * num_pixels);
-        cache.ascii_texture = SDL_CreateTexture(sdl_ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, rect.w, rect.h);
-        SDL_SetTextureBlendMode(cache.ascii_texture, SDL_BLENDMODE_BLEND);
-    }
-
-    /* Draw each char into the pixel buffer. */
-    /* Set entry values. */
-    p = 0;
-    for (i = 0; i < 16; i += 1) {
-        for (j = 0; j < 16; j += 1) {
-            y = i * max_h;
-            x = j * max_w;
-
-            c = i * 16 + j;
-
-            FT_Load_Char(cache.ft_face, c, FT_LOAD_RENDER);
-            g                = cache.ft_face->glyph;
-            b                = g->bitmap;
-
-            cache.ascii_entries[c].texture       = cache.ascii_texture;
-            cache.ascii_entries[c].x             = x;
-            cache.ascii_entries[c].y             = y;
-            cache.ascii_entries[c].w             = b.width;
-            cache.ascii_entries[c].h             = b.rows;
-            cache.ascii_entries[c].adjust_x      = g->bitmap_left;
-            cache.ascii_entries[c].adjust_y      = g->bitmap_top;
-            cache.ascii_entries[c].pen_advance_x = g->advance.x >> 6;
-            cache.ascii_entries[c].pen_advance_y = g->advance.y >> 6;
-
-#define P() (((i * max_h + k) * rect.w) + (j * max_w) + l)
-
-            if (sdl_ren != NULL) {
-                for (k = 0; k < b.rows; k += 1) {
-                    for (l = 0; l < b.width; l += 1) {
-                        m = k * b.width + l;
-                        r = b.buffer[m];
-                        p = P();
-                        pixels[p] = 0xFFFFFF00 | r;
-                    }
-                }
-            }
+    pthread_mutex_lock(&font->file->mtx);
+
+    if (font_raster_scale == 1.0) {
+        if (font->raster_size != NULL) {
+            FT_Done_Size(font->raster_size);
+            font->raster_size = NULL;
+        }
+
+        font->raster_disk = NULL;
+    } else {
+        dpi = lroundf(300 * font_raster_scale);
 
-#undef P
+        if (font->raster_size == NULL
+        &&  FT_New_Size(font->ft_face, &font->raster_size)) {
+            ERR("font size err\n");
         }
+
+        FT_Activate_Size(font->raster_size);
+
+        if (FT_Set_Char_Size(font->ft_face, 0, font->size * 64, dpi, dpi)) {
+            ERR("font size err\n");
+        }
+
+        /* Handles are shared, so coming back to a scale reuses its one. */
+        font->raster_disk = glyph_cache_open(font->path, font->size * 64, dpi);
     }
 
+    pthread_mutex_unlock(&font->file->mtx);
+}
+
+static font_cache_t *publish_font(const char *key, font_cache_t *cache, SDL_Renderer *sdl_ren) {
+    font_map_it it;
+
     if (sdl_ren != NULL) {
-        SDL_UpdateTexture(cache.ascii_texture, &rect, pixels, sizeof(u32) * rect.w);
-        free(pixels);
+        if (font_shared_atlas) {
+            init_shared_font(cache);
+        } else {
+            set_raster_size(cache);
+        }
     }
 
-    it = tree_insert(font_map, strdup(lookup_buff), cache);
+    cache->id = tree_len(font_map);
+
+    it = tree_insert(font_map, strdup(key), *cache);
 
     return &tree_it_val(it);
 }
 
-font_entry_t *get_glyph(font_cache_t *font, char_code_t ch, SDL_Renderer *sdl_ren) {
-    font_entry_map_it  it;
-    FT_Bitmap          b;
-    FT_GlyphSlot       g;
-    u32               *pixels, num_pixels;
-    int                i, j, m, r;
+font_cache_t *get_or_load_font(const char *name, u32 size, SDL_Renderer *sdl_ren) {
+    char          lookup_buff[256];
+    font_map_it   it;
+    font_cache_t  cache;
+
+    snprintf(lookup_buff, sizeof(lookup_buff), "%s:%u", name, size);
+
+    it = tree_lookup(font_map, lookup_buff);
+
+    if (tree_it_good(it)) {
+        return &tree_it_val(it);
+    }
+
+    load_font(&cache, ft_lib, name, size);
+
+    return publish_font(lookup_buff, &cache, sdl_ren);
+}
+
+/*
+ * Loading ahead of time.
+ *
+ * font_preload() queues a font on a thread pool. A task borrows a
+ * library from free_libs for as long as it runs, since faces can't be
+ * created in the same FT_Library concurrently. A face stays tied to the
+ * library it was created in, so libraries are never freed, but there
+ * are only ever as many as there were tasks running at once.
+ * font_finish_preload() waits for the tasks and moves the results into
+ * font_map. Until then, only the tasks touch them.
+ */
+static void async_load_font(void *arg) {
+    font_preload_t *preload;
+    FT_Library      lib;
+
+    preload = arg;
+
+    pthread_mutex_lock(&preload_mtx);
+    if (array_len(free_libs)) {
+        lib = *(FT_Library*)array_last(free_libs);
+        array_pop(free_libs);
+    } else {
+        lib = NULL;
+    }
+    pthread_mutex_unlock(&preload_mtx);
+
+    if (lib == NULL && FT_Init_FreeType(&lib)) {
+        ERR("font init error\n");
+    }
+
+    load_font(&preload->cache, lib, preload->name, preload->size);
+
+    printf("[async_font_load] loaded '%s'\n", preload->key);
+
+    pthread_mutex_lock(&preload_mtx);
+    array_push(free_libs, lib);
+    n_preloads_running -= 1;
+    pthread_cond_signal(&preload_cond);
+    pthread_mutex_unlock(&preload_mtx);
+}
+
+void font_preload(tp_t *tp, const char *name, u32 size) {
+    char             lookup_buff[256];
+    font_preload_t **it;
+    font_preload_t  *preload;
+
+    snprintf(lookup_buff, sizeof(lookup_buff), "%s:%u", name, size);
+
+    if (tree_it_good(tree_lookup(font_map, lookup_buff))) { return; }
+
+    array_traverse(preloads, it) {
+        if (strcmp((*it)->key, lookup_buff) == 0) { return; }
+    }
+
+    preload       = malloc(sizeof(*preload));
+    preload->key  = strdup(lookup_buff);
+    preload->name = strdup(name);
+    preload->size = size;
+
+    array_push(preloads, preload);
+
+    pthread_mutex_lock(&preload_mtx);
+    n_preloads_running += 1;
+    pthread_mutex_unlock(&preload_mtx);
+
+    tp_add_task(tp, async_load_font, preload);
+}
+
+void font_finish_preload(SDL_Renderer *sdl_ren) {
+    font_preload_t **it;
+
+    pthread_mutex_lock(&preload_mtx);
+    while (n_preloads_running > 0) {
+        pthread_cond_wait(&preload_cond, &preload_mtx);
+    }
+    pthread_mutex_unlock(&preload_mtx);
+
+    array_traverse(preloads, it) {
+        publish_font((*it)->key, &(*it)->cache, sdl_ren);
+
+        free((*it)->key);
+        free((*it)->name);
+        free(*it);
+    }
+
+    array_clear(preloads);
+}
+
+static u64 atlas_page_bytes(font_atlas_page_t *page) {
+    return (u64)page->w * (u64)page->h * 4;
+}
+
+static void free_atlas_page(font_atlas_page_t *page) {
+    SDL_DestroyTexture(page->texture);
+    array_free(page->shelves);
+    array_free(page->users);
+
+    atlas_bytes -= atlas_page_bytes(page);
+}
+
+static void evict_atlas_pages(u64 needed);
+
+static font_atlas_page_t *new_atlas_page(array_t *pages, u32 min_w, u32 min_h, SDL_Renderer *sdl_ren) {
+    font_atlas_page_t  page;
+    u32               *pixels;
+
+    memset(&page, 0, sizeof(page));
+
+    page.w       = MAX(FONT_ATLAS_PAGE_SIZE, min_w);
+    page.h       = MAX(FONT_ATLAS_PAGE_SIZE, min_h);
+
+    evict_atlas_pages(atlas_page_bytes(&page));
+
+    page.shelves = array_make(font_atlas_shelf_t);
+    page.users   = array_make(font_entry_t*);
+    page.texture = SDL_CreateTexture(sdl_ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, page.w, page.h);
+
+    atlas_bytes += atlas_page_bytes(&page);
+
+    SDL_SetTextureBlendMode(page.texture, SDL_BLENDMODE_BLEND);
+
+    /* Clear the page so that filtering at glyph edges doesn't pick up garbage. */
+    pixels = (u32*)calloc(page.w * page.h, sizeof(u32));
+    SDL_UpdateTexture(page.texture, NULL, pixels, sizeof(u32) * page.w);
+    free(pixels);
+
+    return array_push(*pages, page);
+}
+
+static int atlas_page_alloc(font_atlas_page_t *page, u32 w, u32 h, u32 *x, u32 *y) {
+    font_atlas_shelf_t *shelf;
+    font_atlas_shelf_t *best;
+    font_atlas_shelf_t  new_shelf;
+
+    if (w > page->w) { return 0; }
+
+    /* Pick the shortest shelf that the glyph fits on. */
+    best = NULL;
+    array_traverse(page->shelves, shelf) {
+        if (shelf->h >= h
+        &&  page->w - shelf->x >= w
+        &&  (best == NULL || shelf->h < best->h)) {
+            best = shelf;
+        }
+    }
+
+    if (best == NULL) {
+        if (page->h - page->next_y < h) { return 0; }
+
+        new_shelf.y   = page->next_y;
+        new_shelf.h   = h;
+        new_shelf.x   = 0;
+        page->next_y += h;
+
+        best = array_push(page->shelves, new_shelf);
+    }
+
+    *x       = best->x;
+    *y       = best->y;
+    best->x += w;
+
+    return 1;
+}
+
+static void atlas_add_glyph(array_t *pages, FT_Bitmap *b, font_entry_t *entry, SDL_Renderer *sdl_ren) {
+    font_atlas_page_t *page;
+    u32                w, h, x, y;
+    u32               *pixels;
+    int                i, j, m;
     SDL_Rect           rect;
-    font_entry_t       entry;
 
-    if (ch < 256) {
-        return &font->ascii_entries[ch];
+    /* Leave a pixel of padding between glyphs. */
+    w = b->width + 1;
+    h = b->rows  + 1;
+
+    /* Newer pages are the most likely to have room. */
+    page = NULL;
+    for (i = array_len(*pages) - 1; i >= 0; i -= 1) {
+        if (atlas_page_alloc(array_item(*pages, i), w, h, &x, &y)) {
+            page = array_item(*pages, i);
+            break;
+        }
+    }
+
+    if (page == NULL) {
+        page = new_atlas_page(pages, w, h, sdl_ren);
+        atlas_page_alloc(page, w, h, &x, &y);
     }
 
-    it = tree_lookup(font->non_ascii_entry_map, ch);
+    pixels = (u32*)malloc(sizeof(u32) * b->width * b->rows);
+
+    for (i = 0; i < b->rows; i += 1) {
+        for (j = 0; j < b->width; j += 1) {
+            m         = i * b->width + j;
+            pixels[m] = 0xFFFFFF00 | b->buffer[i * b->pitch + j];
+        }
+    }
+
+    rect.x = x;
+    rect.y = y;
+    rect.w = b->width;
+    rect.h = b->rows;
+
+    SDL_UpdateTexture(page->texture, &rect, pixels, sizeof(u32) * rect.w);
+    free(pixels);
+
+    page->used_pixels += rect.w * rect.h;
+    page->n_glyphs    += 1;
+
+    array_push(page->users, entry);
+
+    entry->texture = page->texture;
+    entry->x       = x;
+    entry->y       = y;
+}
+
+static font_master_t *get_font_master(const char *path) {
+    font_master_map_it it;
+    font_master_t      master;
+    font_file_t       *file;
+    int                l;
+
+    it = tree_lookup(font_master_map, (char*)path);
 
     if (tree_it_good(it)) {
         return &tree_it_val(it);
     }
 
-    memset(&entry, 0, sizeof(entry));
+    memset(&master, 0, sizeof(master));
 
-    FT_Load_Char(font->ft_face, ch, FT_LOAD_RENDER);
-    g = font->ft_face->glyph;
-    b = g->bitmap;
+    master.path      = strdup(path);
+    master.cur_level = -1;
 
-    num_pixels = b.width * b.rows;
+    file = get_font_file(path);
 
-    rect.x = rect.y = 0;
-    rect.w = b.width;
-    rect.h = b.rows;
+    pthread_mutex_lock(&file->mtx);
+    open_font_file(file, ft_lib);
+    pthread_mutex_unlock(&file->mtx);
 
-    if (sdl_ren != NULL) {
-        pixels = (u32*)malloc(sizeof(u32) * num_pixels);
-        memset(pixels, 0, sizeof(u32) * num_pixels);
-        entry.texture = SDL_CreateTexture(sdl_ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, rect.w, rect.h);
-        SDL_SetTextureBlendMode(entry.texture, SDL_BLENDMODE_BLEND);
+    master.ft_face = file->ft_face;
+
+    if (FT_New_Size(master.ft_face, &master.ft_size)) {
+        ERR("font size err\n");
     }
 
-    entry.x             = rect.x;
-    entry.y             = rect.y;
-    entry.w             = rect.w;
-    entry.h             = rect.h;
-    entry.adjust_x      = g->bitmap_left;
-    entry.adjust_y      = g->bitmap_top;
-    entry.pen_advance_x = g->advance.x >> 6;
-    entry.pen_advance_y = g->advance.y >> 6;
+    for (l = 0; l < FONT_MASTER_LEVELS; l += 1) {
+        master.atlas_pages[l] = array_make(font_atlas_page_t);
+        master.glyph_pages[l] = array_make(font_glyph_page_t*);
+    }
 
+    it = tree_insert(font_master_map, master.path, master);
 
-    if (sdl_ren != NULL) {
-        for (i = 0; i < b.rows; i += 1) {
-            for (j = 0; j < b.width; j += 1) {
-                m         = i * b.width + j;
-                r         = b.buffer[m];
-                pixels[m] = 0xFFFFFF00 | r;
+    return &tree_it_val(it);
+}
+
+/*
+ * Gets the metrics and bitmap of ch from the glyph cache on disk if it's
+ * there and renders it with FreeType otherwise. The bitmap is only valid
+ * until the next glyph is loaded with face.
+ */
+static void render_glyph(FT_Face face, glyph_cache_t *disk, char_code_t ch, glyph_cache_metrics_t *m, FT_Bitmap *b) {
+    unsigned char *bitmap;
+    FT_GlyphSlot   g;
+
+    if (disk != NULL && glyph_cache_get(disk, ch, m, &bitmap)) {
+        memset(b, 0, sizeof(*b));
+
+        b->width      = m->w;
+        b->rows       = m->h;
+        b->pitch      = m->w;
+        b->buffer     = bitmap;
+        b->pixel_mode = FT_PIXEL_MODE_GRAY;
+
+        return;
+    }
+
+    FT_Load_Char(face, ch, FT_LOAD_RENDER);
+    g  = face->glyph;
+    *b = g->bitmap;
+
+    m->adjust_x      = g->bitmap_left;
+    m->adjust_y      = g->bitmap_top;
+    m->pen_advance_x = g->advance.x >> 6;
+    m->pen_advance_y = g->advance.y >> 6;
+    m->w             = b->width;
+    m->h             = b->rows;
+
+    if (disk != NULL) {
+        glyph_cache_add(disk, ch, m, b->buffer, b->pitch);
+    }
+}
+
+/* The page of the table that holds ch, allocating it if needed. */
+static font_glyph_page_t *get_glyph_page(array_t *pages, char_code_t ch) {
+    u32                 idx;
+    font_glyph_page_t  *null_page;
+    font_glyph_page_t **page;
+
+    idx       = ch >> FONT_GLYPH_PAGE_BITS;
+    null_page = NULL;
+
+    while (array_len(*pages) <= idx) {
+        array_push(*pages, null_page);
+    }
+
+    page = array_item(*pages, idx);
+
+    if (*page == NULL) {
+        *page = malloc(sizeof(**page));
+        memset(*page, 0, sizeof(**page));
+    }
+
+    return *page;
+}
+
+#define GLYPH_LOADED(page, i)     ((page)->loaded[(i) / 8] & (1 << ((i) % 8)))
+#define SET_GLYPH_LOADED(page, i) ((page)->loaded[(i) / 8] |= (1 << ((i) % 8)))
+
+/* A glyph that had an image until its atlas page was evicted. */
+#define GLYPH_EVICTED(entry) ((entry)->texture == NULL && (entry)->src_w != 0 && (entry)->src_h != 0)
+
+static font_entry_t *get_master_glyph(font_master_t *master, int level, char_code_t ch, SDL_Renderer *sdl_ren) {
+    font_glyph_page_t     *page;
+    u32                    i;
+    FT_Bitmap              b;
+    glyph_cache_metrics_t  m;
+    font_entry_t          *entry;
+
+    page = get_glyph_page(&master->glyph_pages[level], ch);
+    i    = ch & (FONT_GLYPH_PAGE_SIZE - 1);
+
+    if (GLYPH_LOADED(page, i) && !GLYPH_EVICTED(&page->entries[i])) {
+        return &page->entries[i];
+    }
+
+    FT_Activate_Size(master->ft_size);
+
+    if (master->cur_level != level) {
+        FT_Set_Pixel_Sizes(master->ft_face, 0, FONT_MASTER_LEVEL_PX(level));
+        master->cur_level = level;
+    }
+
+    /* A pixel size is the same as a point size at 72 DPI. */
+    if (master->disk[level] == NULL) {
+        master->disk[level] = glyph_cache_open(master->path, FONT_MASTER_LEVEL_PX(level) * 64, 72);
+    }
+
+    entry = &page->entries[i];
+
+    memset(entry, 0, sizeof(*entry));
+
+    render_glyph(master->ft_face, master->disk[level], ch, &m, &b);
+
+    entry->src_w    = entry->w = b.width;
+    entry->src_h    = entry->h = b.rows;
+    entry->adjust_x = m.adjust_x;
+    entry->adjust_y = m.adjust_y;
+
+    if (b.width > 0 && b.rows > 0) {
+        atlas_add_glyph(&master->atlas_pages[level], &b, entry, sdl_ren);
+    }
+
+    SET_GLYPH_LOADED(page, i);
+
+    return entry;
+}
+
+/*
+ * Points a glyph of a font that uses a shared atlas at the master glyph
+ * it is drawn from. Only the image changes with the raster scale: the
+ * box is the size's own, so entries stay valid for compiled layout.
+ */
+static void set_shared_glyph_image(font_cache_t *font, char_code_t ch, font_entry_t *entry, SDL_Renderer *sdl_ren) {
+    font_entry_t      *m;
+    font_atlas_page_t *page;
+
+    m = get_master_glyph(font->master, font->master_level, ch, sdl_ren);
+
+    entry->texture = m->texture;
+    entry->x       = m->x;
+    entry->y       = m->y;
+    entry->src_w   = m->src_w;
+    entry->src_h   = m->src_h;
+
+    /* So that evicting the master glyph's page evicts this one too. */
+    if (m->texture != NULL) {
+        array_rtraverse(font->master->atlas_pages[font->master_level], page) {
+            if (page->texture == m->texture) {
+                array_push(page->users, entry);
+                break;
             }
         }
     }
+}
 
-    if (sdl_ren != NULL) {
-        SDL_UpdateTexture(entry.texture, &rect, pixels, sizeof(u32) * rect.w);
-        free(pixels);
+/*
+ * Metrics of the loaded glyph, with the box that rendering it would
+ * produce (its control box, grown to whole pixels), without rendering.
+ */
+static void loaded_glyph_metrics(FT_GlyphSlot g, glyph_cache_metrics_t *m) {
+    FT_BBox cbox;
+
+    m->pen_advance_x = g->advance.x >> 6;
+    m->pen_advance_y = g->advance.y >> 6;
+
+    if (g->format != FT_GLYPH_FORMAT_OUTLINE) {
+        m->adjust_x = g->bitmap_left;
+        m->adjust_y = g->bitmap_top;
+        m->w        = g->bitmap.width;
+        m->h        = g->bitmap.rows;
+        return;
     }
 
-    it = tree_insert(font->non_ascii_entry_map, ch, entry);
+    FT_Outline_Get_CBox(&g->outline, &cbox);
 
-    return &tree_it_val(it);
+    cbox.xMin &= ~63;
+    cbox.yMin &= ~63;
+    cbox.xMax  = (cbox.xMax + 63) & ~63;
+    cbox.yMax  = (cbox.yMax + 63) & ~63;
+
+    m->adjust_x = cbox.xMin >> 6;
+    m->adjust_y = cbox.yMax >> 6;
+    m->w        = (cbox.xMax - cbox.xMin) >> 6;
+    m->h        = (cbox.yMax - cbox.yMin) >> 6;
 }
 
-static const unsigned char _utf8_lens[] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 4, 0
-};
+/*
+ * A glyph of a font that uses a shared atlas: the box and advance come
+ * from the font's own size, as they would without a raster scale, and
+ * the image is the master glyph scaled into the box. Both share the
+ * face's glyph slot, so the metrics are taken first.
+ */
+static void get_shared_glyph(font_cache_t *font, char_code_t ch, font_entry_t *entry, SDL_Renderer *sdl_ren) {
+    glyph_cache_metrics_t m;
 
-#define G_IS_ASCII(g) (!((g)[0] >> 7))
+    FT_Load_Char(font_face(font), ch, FT_LOAD_DEFAULT);
+    loaded_glyph_metrics(font->ft_face->glyph, &m);
 
-#define _get_glyph_len(g)                 \
-(likely(G_IS_ASCII(g))                    \
-    ? 1                                   \
-    : (int)(_utf8_lens[(g)[0] >> 3ULL]))
+    entry->w             = m.w;
+    entry->h             = m.h;
+    entry->adjust_x      = m.adjust_x;
+    entry->adjust_y      = m.adjust_y;
+    entry->pen_advance_x = m.pen_advance_x;
+    entry->pen_advance_y = m.pen_advance_y;
 
-char_code_t get_char_code(const char *str, int *n_bytes) {
-    unsigned char *bytes;
-    wchar_t        wch;
-    char_code_t    char_code;
+    set_shared_glyph_image(font, ch, entry, sdl_ren);
+}
+
+/* Rows of the bitmap that rendering the loaded glyph would produce. */
+static u32 loaded_glyph_rows(FT_GlyphSlot g) {
+    glyph_cache_metrics_t m;
 
-    bytes = (unsigned char*)str;
+    loaded_glyph_metrics(g, &m);
 
-    *n_bytes = _get_glyph_len(bytes);
+    return m.h;
+}
 
-    /* Reset the shift state. */
-    mbtowc(NULL, 0, 0);
+static void init_shared_font(font_cache_t *font) {
+    float size_px;
+    float raster_px;
+    int   level;
 
-    mbtowc(&wch, (const char*)str, *n_bytes);
+    size_px   = font->size * 300.0 / 72.0;
+    raster_px = size_px * font_raster_scale;
 
-    char_code = wch;
+    level = 0;
+    while (level + 1 < FONT_MASTER_LEVELS
+    &&     FONT_MASTER_LEVEL_PX(level + 1) >= raster_px) {
+        level += 1;
+    }
 
-    return char_code;
+    font->master       = get_font_master(font->path);
+    font->master_level = level;
 }
 
-void set_font_color(font_cache_t *font, int r, int g, int b) {
-    font_entry_map_it it;
+/*
+ * The line height is the height of the tallest rendered glyph in the
+ * first 256 codes. Hinting only moves glyph edges by a pixel or so, so
+ * it is enough to look at the glyphs that are tallest when unscaled.
+ */
+static u32 get_line_height(font_cache_t *font) {
+    FT_Face face;
+    u32     line_height;
+    u32     rows;
+    int     k;
+
+    face        = font_face(font);
+    line_height = 0;
+
+    for (k = 0; k < FONT_LINE_HEIGHT_CANDIDATES; k += 1) {
+        FT_Load_Char(face, font->file->tallest[k], FT_LOAD_DEFAULT);
+
+        rows = loaded_glyph_rows(face->glyph);
+        if (rows > line_height) { line_height = rows; }
+    }
+
+    return line_height;
+}
+
+/*
+ * The codes that a file's face has glyphs for, as a bitset over all of
+ * Unicode, built once from its character map.
+ */
+static const unsigned char *get_font_coverage(font_file_t *file) {
+    FT_ULong code;
+    FT_UInt  glyph;
+
+    pthread_mutex_lock(&file->mtx);
+
+    if (file->coverage == NULL) {
+        open_font_file(file, ft_lib);
+
+        file->coverage = calloc((FONT_MAX_CHAR_CODE + 1) / 8, 1);
+
+        code = FT_Get_First_Char(file->ft_face, &glyph);
+        while (glyph != 0) {
+            if (code <= FONT_MAX_CHAR_CODE) {
+                file->coverage[code / 8] |= 1 << (code % 8);
+            }
+            code = FT_Get_Next_Char(file->ft_face, code, &glyph);
+        }
+    }
+
+    pthread_mutex_unlock(&file->mtx);
+
+    return file->coverage;
+}
 
-    SDL_SetTextureColorMod(font->ascii_texture, r, g, b);
+static int font_file_covers(font_file_t *file, char_code_t ch) {
+    return ch <= FONT_MAX_CHAR_CODE && (get_font_coverage(file)[ch / 8] & (1 << (ch % 8)));
+}
+
+/*
+ * The font that a code is taken from: the font itself if its face has
+ * the code, otherwise the first of its fallbacks, at the same size, that
+ * does. Codes that no font has come from the font itself (as .notdef).
+ */
+static font_cache_t *resolve_fallback(font_cache_t *font, char_code_t ch, SDL_Renderer *sdl_ren) {
+    char **path;
 
-    tree_traverse(font->non_ascii_entry_map, it) {
-        SDL_SetTextureColorMod(tree_it_val(it).texture, r, g, b);
+    if (likely(array_len(font->fallbacks) == 0) || font_file_covers(font->file, ch)) {
+        return font;
     }
+
+    array_traverse(font->fallbacks, path) {
+        if (font_file_covers(get_font_file(*path), ch)) {
+            return get_or_load_font(*path, font->size, sdl_ren);
+        }
+    }
+
+    return font;
+}
+
+/*
+ * Forgets the glyphs in page that the font's own face doesn't have.
+ * Returns the number forgotten.
+ */
+static int forget_uncovered_glyphs(font_cache_t *font, font_glyph_page_t *page, char_code_t base) {
+    int i;
+    int n;
+
+    n = 0;
+    for (i = 0; i < FONT_GLYPH_PAGE_SIZE; i += 1) {
+        if (GLYPH_LOADED(page, i) && !font_file_covers(font->file, base + i)) {
+            page->loaded[i / 8] &= ~(1 << (i % 8));
+            n += 1;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Sets the fonts that codes missing from the font's face are taken from,
+ * in order. Glyphs are resolved once, when they're loaded, so changing
+ * the chain forgets the ones that were resolved through it.
+ * Returns 1 if any glyphs were forgotten. They are loaded again into the
+ * same entries, so anything drawn with them is out of date.
+ */
+int font_set_fallbacks(font_cache_t *font, array_t *paths) {
+    array_t             chain;
+    char              **it;
+    char               *path;
+    font_glyph_page_t **page;
+    int                 i;
+    int                 same;
+    int                 n_forgotten;
+
+    /* A font doesn't fall back to itself. */
+    chain = array_make(char*);
+    array_traverse(*paths, it) {
+        if (strcmp(*it, font->path) != 0) {
+            array_push(chain, *it);
+        }
+    }
+
+    same = array_len(font->fallbacks) == array_len(chain);
+
+    for (i = 0; same && i < array_len(chain); i += 1) {
+        same = strcmp(*(char**)array_item(font->fallbacks, i), *(char**)array_item(chain, i)) == 0;
+    }
+
+    if (same) {
+        array_free(chain);
+        return 0;
+    }
+
+    array_traverse(font->fallbacks, it) { free(*it); }
+    array_clear(font->fallbacks);
+
+    array_traverse(chain, it) {
+        path = strdup(*it);
+        array_push(font->fallbacks, path);
+    }
+
+    array_free(chain);
+
+    n_forgotten = forget_uncovered_glyphs(font, &font->first_page, 0);
+
+    i = 0;
+    array_traverse(font->glyph_pages, page) {
+        if (*page != NULL) {
+            n_forgotten += forget_uncovered_glyphs(font, *page, i << FONT_GLYPH_PAGE_BITS);
+        }
+        i += 1;
+    }
+
+    return n_forgotten > 0;
+}
+
+/*
+ * Renders the image of a glyph at the raster scale into the atlas. The
+ * entry's box and advance are left as they are.
+ */
+static void raster_glyph(font_cache_t *font, char_code_t ch, font_entry_t *entry, SDL_Renderer *sdl_ren) {
+    FT_Bitmap              b;
+    glyph_cache_metrics_t  m;
+
+    if (font->raster_size != NULL) {
+        FT_Activate_Size(font->raster_size);
+        render_glyph(font->ft_face, font->raster_disk, ch, &m, &b);
+    } else {
+        render_glyph(font_face(font), font->disk, ch, &m, &b);
+    }
+
+    entry->texture = NULL;
+    entry->x       = 0;
+    entry->y       = 0;
+    entry->src_w   = b.width;
+    entry->src_h   = b.rows;
+
+    if (b.width > 0 && b.rows > 0) {
+        atlas_add_glyph(&font->atlas_pages, &b, entry, sdl_ren);
+    }
+}
+
+static void load_glyph(font_cache_t *font, char_code_t ch, font_entry_t *entry, SDL_Renderer *sdl_ren) {
+    FT_Bitmap              b;
+    glyph_cache_metrics_t  m;
+    font_cache_t          *from;
+
+    from = resolve_fallback(font, ch, sdl_ren);
+
+    if (from != font) {
+        load_glyph(from, ch, entry, sdl_ren);
+        return;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+
+    entry->last_used = font_frame;
+    entry->code      = ch;
+    entry->font      = font;
+
+    if (font->master != NULL && sdl_ren != NULL) {
+        get_shared_glyph(font, ch, entry, sdl_ren);
+        return;
+    }
+
+    /*
+     * Without a renderer (--check and PDF export) glyphs are never drawn,
+     * so only their outlines are loaded for the metrics. At a raster
+     * scale other than 1, the box and advance come from those metrics
+     * and the image from raster_glyph().
+     */
+    if (sdl_ren == NULL || font->raster_size != NULL) {
+        FT_Load_Char(font_face(font), ch, FT_LOAD_DEFAULT);
+        loaded_glyph_metrics(font->ft_face->glyph, &m);
+
+        entry->src_w         = m.w;
+        entry->src_h         = m.h;
+        entry->w             = m.w;
+        entry->h             = m.h;
+        entry->adjust_x      = m.adjust_x;
+        entry->adjust_y      = m.adjust_y;
+        entry->pen_advance_x = m.pen_advance_x;
+        entry->pen_advance_y = m.pen_advance_y;
+
+        if (sdl_ren != NULL) {
+            raster_glyph(font, ch, entry, sdl_ren);
+        }
+
+        return;
+    }
+
+    render_glyph(font_face(font), font->disk, ch, &m, &b);
+
+    entry->src_w         = b.width;
+    entry->src_h         = b.rows;
+    entry->w             = b.width;
+    entry->h             = b.rows;
+    entry->adjust_x      = m.adjust_x;
+    entry->adjust_y      = m.adjust_y;
+    entry->pen_advance_x = m.pen_advance_x;
+    entry->pen_advance_y = m.pen_advance_y;
+
+    if (b.width > 0 && b.rows > 0) {
+        atlas_add_glyph(&font->atlas_pages, &b, entry, sdl_ren);
+    }
+}
+
+/*
+ * The slow path of get_glyph(), kept out of line so that looking up a
+ * glyph that is already loaded doesn't have to set up a stack frame.
+ */
+__attribute__((noinline))
+static font_entry_t *load_table_glyph(font_cache_t *font, char_code_t ch, SDL_Renderer *sdl_ren) {
+    font_glyph_page_t *page;
+    u32                i;
+
+    if (ch < FONT_GLYPH_PAGE_SIZE) {
+        page = &font->first_page;
+    } else {
+        if (ch > FONT_MAX_CHAR_CODE) { ch = 0xFFFD; }
+
+        page = get_glyph_page(&font->glyph_pages, ch);
+    }
+
+    i = ch & (FONT_GLYPH_PAGE_SIZE - 1);
+
+    if (!GLYPH_LOADED(page, i)) {
+        load_glyph(font, ch, &page->entries[i], sdl_ren);
+        SET_GLYPH_LOADED(page, i);
+    }
+
+    return &page->entries[i];
+}
+
+font_entry_t *get_glyph(font_cache_t *font, char_code_t ch, SDL_Renderer *sdl_ren) {
+    font_glyph_page_t *page;
+    u64                idx;
+    u32                i;
+
+    idx = ch >> FONT_GLYPH_PAGE_BITS;
+
+    if (likely(idx == 0)) {
+        page = &font->first_page;
+    } else if (likely(idx < (u64)array_len(font->glyph_pages))) {
+        page = *(font_glyph_page_t**)array_item(font->glyph_pages, idx);
+        if (unlikely(page == NULL)) { goto load; }
+    } else {
+        goto load;
+    }
+
+    i = ch & (FONT_GLYPH_PAGE_SIZE - 1);
+
+    if (likely(GLYPH_LOADED(page, i))) {
+        return &page->entries[i];
+    }
+
+load:;
+    return load_table_glyph(font, ch, sdl_ren);
+}
+
+static void free_atlas_pages(array_t *pages) {
+    font_atlas_page_t *page;
+
+    array_traverse(*pages, page) {
+        free_atlas_page(page);
+    }
+
+    array_clear(*pages);
+}
+
+/* The last frame that a glyph was drawn from the page in. */
+static u32 atlas_page_last_used(font_atlas_page_t *page) {
+    font_entry_t **it;
+    u32            last_used;
+
+    last_used = 0;
+
+    array_traverse(page->users, it) {
+        if ((*it)->texture == page->texture) {
+            last_used = MAX(last_used, (*it)->last_used);
+        }
+    }
+
+    return last_used;
+}
+
+static void evict_atlas_page(array_t *pages, int idx) {
+    font_atlas_page_t  *page;
+    font_entry_t      **it;
+
+    page = array_item(*pages, idx);
+
+    /* Users that moved to another page since don't count. */
+    array_traverse(page->users, it) {
+        if ((*it)->texture == page->texture) {
+            (*it)->texture  = NULL;
+            evicted_glyphs += 1;
+        }
+    }
+
+    free_atlas_page(page);
+    array_delete(*pages, idx);
+
+    atlas_evictions += 1;
+}
+
+typedef struct {
+    array_t *pages;
+    int      idx;
+    u32      last_used;
+} lru_page_t;
+
+static void find_lru_page(array_t *pages, lru_page_t *lru) {
+    int i;
+    u32 last_used;
+
+    for (i = 0; i < array_len(*pages); i += 1) {
+        last_used = atlas_page_last_used(array_item(*pages, i));
+
+        if (last_used == font_frame) { continue; }
+
+        if (lru->pages == NULL || last_used < lru->last_used) {
+            lru->pages     = pages;
+            lru->idx       = i;
+            lru->last_used = last_used;
+        }
+    }
+}
+
+/* Makes room for needed more bytes of pages, see FONT_ATLAS_DEFAULT_BUDGET_MB. */
+static void evict_atlas_pages(u64 needed) {
+    lru_page_t         lru;
+    font_map_it        it;
+    font_master_map_it mit;
+    int                l;
+
+    while (atlas_bytes + needed > font_atlas_budget) {
+        memset(&lru, 0, sizeof(lru));
+
+        tree_traverse(font_map, it) {
+            find_lru_page(&tree_it_val(it).atlas_pages, &lru);
+        }
+
+        tree_traverse(font_master_map, mit) {
+            for (l = 0; l < FONT_MASTER_LEVELS; l += 1) {
+                find_lru_page(&tree_it_val(mit).atlas_pages[l], &lru);
+            }
+        }
+
+        if (lru.pages == NULL) { break; }
+
+        evict_atlas_page(lru.pages, lru.idx);
+    }
+}
+
+/*
+ * Called after drawing each frame. Pages that are over budget because
+ * they were loaded or drawn from since the last frame are evicted here
+ * once they go unused.
+ */
+void font_end_frame(void) {
+    evict_atlas_pages(0);
+    font_frame += 1;
+}
+
+/*
+ * Rasterises a glyph again after its atlas page was evicted.
+ * Returns 0 if it has no image to draw.
+ */
+int font_restore_glyph(font_entry_t *entry, SDL_Renderer *sdl_ren) {
+    if (!GLYPH_EVICTED(entry) || entry->font == NULL) { return 0; }
+
+    if (entry->font->master != NULL) {
+        set_shared_glyph_image(entry->font, entry->code, entry, sdl_ren);
+    } else {
+        raster_glyph(entry->font, entry->code, entry, sdl_ren);
+    }
+
+    restored_glyphs += 1;
+
+    return entry->texture != NULL;
+}
+
+/* Tallest first, which packs shelves best. */
+static int cmp_entry_height(const void *a, const void *b) {
+    return (int)(*(font_entry_t* const*)b)->h - (int)(*(font_entry_t* const*)a)->h;
+}
+
+/* Drops the font's glyph images and sets it up for the current raster scale. */
+static void reset_font_raster(font_cache_t *font) {
+    if (font->master != NULL) {
+        init_shared_font(font);
+    } else {
+        free_atlas_pages(&font->atlas_pages);
+        set_raster_size(font);
+    }
+}
+
+/*
+ * Renders every glyph that the font has loaded again, for the current
+ * raster scale. Entries stay where they are. Glyphs that came from a
+ * fallback are rendered by that font, so every font must have been reset
+ * first. Evicted glyphs are left to font_restore_glyph(), and the rest
+ * count as used now, so that the pages they land on aren't the first
+ * ones evicted to make room for the rest of the pass.
+ */
+static void reraster_font(font_cache_t *font, SDL_Renderer *sdl_ren) {
+    array_t             glyphs;
+    font_entry_t       *entry;
+    font_entry_t      **it;
+    font_glyph_page_t  *page;
+    int                 n_pages;
+    int                 p, i;
+
+    glyphs = array_make(font_entry_t*);
+
+    /* glyph_pages[0] is never used: those are in first_page. */
+    n_pages = MAX(1, array_len(font->glyph_pages));
+
+    for (p = 0; p < n_pages; p += 1) {
+        if (p == 0) {
+            page = &font->first_page;
+        } else {
+            page = *(font_glyph_page_t**)array_item(font->glyph_pages, p);
+            if (page == NULL) { continue; }
+        }
+
+        for (i = 0; i < FONT_GLYPH_PAGE_SIZE; i += 1) {
+            if (!GLYPH_LOADED(page, i)) { continue; }
+
+            entry = &page->entries[i];
+
+            /* Resetting left the texture pointers alone, so this still tells. */
+            if (GLYPH_EVICTED(entry)) { continue; }
+
+            array_push(glyphs, entry);
+        }
+    }
+
+    qsort(array_data(glyphs), array_len(glyphs), sizeof(entry), cmp_entry_height);
+
+    array_traverse(glyphs, it) {
+        entry            = *it;
+        entry->last_used = font_frame;
+
+        if (entry->font->master != NULL) {
+            set_shared_glyph_image(entry->font, entry->code, entry, sdl_ren);
+        } else {
+            raster_glyph(entry->font, entry->code, entry, sdl_ren);
+        }
+    }
+
+    array_free(glyphs);
+}
+
+/* Drops master levels that no size draws from anymore. */
+static void free_unused_master_levels(void) {
+    font_master_map_it   mit;
+    font_map_it          it;
+    font_master_t       *master;
+    font_glyph_page_t  **pit;
+    int                  used[FONT_MASTER_LEVELS];
+    int                  l;
+
+    tree_traverse(font_master_map, mit) {
+        master = &tree_it_val(mit);
+
+        memset(used, 0, sizeof(used));
+        tree_traverse(font_map, it) {
+            if (tree_it_val(it).master == master) {
+                used[tree_it_val(it).master_level] = 1;
+            }
+        }
+
+        for (l = 0; l < FONT_MASTER_LEVELS; l += 1) {
+            if (used[l]) { continue; }
+
+            free_atlas_pages(&master->atlas_pages[l]);
+
+            array_traverse(master->glyph_pages[l], pit) {
+                free(*pit);
+            }
+            array_clear(master->glyph_pages[l]);
+        }
+    }
+}
+
+/*
+ * Sets the scale that glyph images are rasterised at (see
+ * FONT_RASTER_SCALE_STEP). If that changes the rounded scale, every
+ * loaded glyph is rasterised again in place. Display lists stay valid,
+ * but anything drawn from them before (slide cache, thumbnails) is out
+ * of date. Returns 1 if glyphs were rasterised again.
+ */
+int font_set_raster_scale(float scale, SDL_Renderer *sdl_ren) {
+    font_map_it it;
+
+    /* A little slack so that a scale of 1.0001 doesn't round up. */
+    scale = ceilf(scale / FONT_RASTER_SCALE_STEP - 0.01) * FONT_RASTER_SCALE_STEP;
+    scale = MAX(FONT_RASTER_SCALE_MIN, MIN(FONT_RASTER_SCALE_MAX, scale));
+
+    if (scale == font_raster_scale) { return 0; }
+
+    font_raster_scale = scale;
+
+    tree_traverse(font_map, it) {
+        reset_font_raster(&tree_it_val(it));
+    }
+
+    tree_traverse(font_map, it) {
+        reraster_font(&tree_it_val(it), sdl_ren);
+    }
+
+    if (font_shared_atlas) {
+        free_unused_master_levels();
+    }
+
+    return 1;
+}
+
+static font_kern_pair_t *kern_slot(font_kern_pair_t *pairs, u32 bits, u64 key) {
+    u32 mask;
+    u32 i;
+
+    mask = (1 << bits) - 1;
+    i    = (key * 0x9E3779B97F4A7C15ULL) >> (64 - bits);
+
+    while (pairs[i].key != 0 && pairs[i].key != key) {
+        i = (i + 1) & mask;
+    }
+
+    return &pairs[i];
+}
+
+static void grow_kern_pairs(font_cache_t *font) {
+    font_kern_pair_t *old;
+    u32               old_size;
+    u32               i;
+
+    old      = font->kern_pairs;
+    old_size = old == NULL ? 0 : 1 << font->kern_bits;
+
+    font->kern_bits  = old == NULL ? FONT_KERN_MIN_BITS : font->kern_bits + 1;
+    font->kern_pairs = calloc(1 << font->kern_bits, sizeof(font_kern_pair_t));
+
+    for (i = 0; i < old_size; i += 1) {
+        if (old[i].key != 0) {
+            *kern_slot(font->kern_pairs, font->kern_bits, old[i].key) = old[i];
+        }
+    }
+
+    free(old);
+}
+
+/* Kerning between two codes in layout pixels. */
+i32 get_kerning(font_cache_t *font, char_code_t left, char_code_t right) {
+    FT_Face           face;
+    FT_Vector         kerning;
+    font_kern_pair_t *slot;
+    u64               key;
+
+    if (!font->has_kerning || left == 0 || right == 0) { return 0; }
+
+    if (left > FONT_MAX_CHAR_CODE)  { left  = 0xFFFD; }
+    if (right > FONT_MAX_CHAR_CODE) { right = 0xFFFD; }
+
+    key = (left << 32) | right;
+
+    if (font->kern_pairs != NULL) {
+        slot = kern_slot(font->kern_pairs, font->kern_bits, key);
+        if (slot->key == key) { return slot->x; }
+    }
+
+    /* Keep the table at most half full. */
+    if (font->kern_pairs == NULL || 2 * (font->n_kern_pairs + 1) > (1u << font->kern_bits)) {
+        grow_kern_pairs(font);
+    }
+
+    face = font_face(font);
+
+    FT_Get_Kerning(face,
+                   FT_Get_Char_Index(face, left),
+                   FT_Get_Char_Index(face, right),
+                   FT_KERNING_DEFAULT,
+                   &kerning);
+
+    slot      = kern_slot(font->kern_pairs, font->kern_bits, key);
+    slot->key = key;
+    slot->x   = kerning.x >> 6;
+
+    font->n_kern_pairs += 1;
+
+    return slot->x;
+}
+
+/*
+ * The kerning after each of len codes, to be added to its advance. The
+ * last one is 0, and so is the zero terminator past it.
+ */
+array_t get_kerning_offsets(font_cache_t *font, const u32 *codes, int len) {
+    array_t offsets;
+    i32     x;
+    int     i;
+
+    offsets = array_make_with_cap(i32, len + 1);
+
+    for (i = 0; i < len; i += 1) {
+        x = i + 1 < len ? get_kerning(font, codes[i], codes[i + 1]) : 0;
+        array_push(offsets, x);
+    }
+
+    array_zero_term(offsets);
+
+    return offsets;
+}
+
+/* Lookups as get_glyph() did them before the table, for the benchmark below. */
+__attribute__((noinline))
+static font_entry_t *bench_tree_glyph(font_cache_t *font, font_entry_map_t tree, char_code_t ch) {
+    font_entry_map_it it;
+
+    if (ch < FONT_GLYPH_PAGE_SIZE) {
+        if (!GLYPH_LOADED(&font->first_page, ch)) { return NULL; }
+        return &font->first_page.entries[ch];
+    }
+
+    it = tree_lookup(tree, ch);
+
+    return tree_it_good(it) ? &tree_it_val(it) : NULL;
+}
+
+__attribute__((noinline))
+static font_entry_t *bench_table_glyph(font_cache_t *font, char_code_t ch, SDL_Renderer *sdl_ren) {
+    return get_glyph(font, ch, sdl_ren);
+}
+
+/*
+ * Times looking up every code in codes, over and over, through
+ * get_glyph() and through the red-black tree that non-ASCII glyphs used
+ * to be kept in (with the same inline array for codes below 256), for
+ * every loaded font. Each is timed a few times and the best run counts.
+ * For --bench-glyphs.
+ */
+void font_bench_glyph_lookup(const u32 *codes, int n_codes, SDL_Renderer *sdl_ren) {
+    font_map_it        it;
+    font_cache_t      *font;
+    font_entry_map_t   tree;
+    font_entry_t      *entry;
+    int                n_rounds;
+    int                n_non_ascii;
+    int                round;
+    int                rep;
+    int                i;
+    u64                start;
+    u64                ns;
+    u64                table_ns, tree_ns;
+    u64                sum;
+
+    if (n_codes == 0) { return; }
+
+    n_rounds = 10000000 / n_codes + 1;
+    sum      = 0;
+
+    tree_traverse(font_map, it) {
+        font = &tree_it_val(it);
+        tree = tree_make(char_code_t, font_entry_t);
+
+        n_non_ascii = 0;
+        for (i = 0; i < n_codes; i += 1) {
+            entry = get_glyph(font, codes[i], sdl_ren);
+
+            if (codes[i] >= FONT_GLYPH_PAGE_SIZE) {
+                tree_insert(tree, codes[i], *entry);
+                n_non_ascii += 1;
+            }
+        }
+
+        table_ns = tree_ns = -1ULL;
+
+        for (rep = 0; rep < 3; rep += 1) {
+            start = gettime_ns();
+            for (round = 0; round < n_rounds; round += 1) {
+                for (i = 0; i < n_codes; i += 1) {
+                    sum += bench_table_glyph(font, codes[i], sdl_ren)->pen_advance_x;
+                }
+            }
+            ns       = gettime_ns() - start;
+            table_ns = MIN(table_ns, ns);
+
+            start = gettime_ns();
+            for (round = 0; round < n_rounds; round += 1) {
+                for (i = 0; i < n_codes; i += 1) {
+                    sum += bench_tree_glyph(font, tree, codes[i])->pen_advance_x;
+                }
+            }
+            ns      = gettime_ns() - start;
+            tree_ns = MIN(tree_ns, ns);
+        }
+
+        printf("[bench glyphs] %s: %d codes (%d non-ASCII), table %.2f ns, tree %.2f ns per lookup\n",
+               tree_it_key(it),
+               n_codes,
+               n_non_ascii,
+               (double)table_ns / ((u64)n_rounds * n_codes),
+               (double)tree_ns  / ((u64)n_rounds * n_codes));
+
+        tree_free(tree);
+    }
+
+    /* Keeps the loops from being optimised away. */
+    if (sum == 0) { printf("[bench glyphs] no advances\n"); }
+}
+
+static const unsigned char _utf8_lens[] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 3, 3, 4, 0
+};
+
+static const u32 _utf8_mins[] = { 0, 0, 0x80, 0x800, 0x10000 };
+
+/*
+ * Decodes one UTF-8 character. Malformed input (stray continuation
+ * bytes, truncated, overlong or surrogate sequences) decodes to U+FFFD
+ * and uses up a single byte, so a terminating NUL is never skipped.
+ * Doesn't depend on the locale.
+ */
+char_code_t get_char_code(const char *str, int *n_bytes) {
+    const unsigned char *bytes;
+    u32                  code;
+    int                  len;
+    int                  i;
+
+    bytes = (const unsigned char*)str;
+
+    if (likely(bytes[0] < 0x80)) {
+        *n_bytes = 1;
+        return bytes[0];
+    }
+
+    len = _utf8_lens[bytes[0] >> 3];
+
+    if (len < 2) { goto bad; }
+
+    code = bytes[0] & (0x7F >> len);
+
+    for (i = 1; i < len; i += 1) {
+        if ((bytes[i] & 0xC0) != 0x80) { goto bad; }
+        code = (code << 6) | (bytes[i] & 0x3F);
+    }
+
+    if (code < _utf8_mins[len]
+    ||  code > 0x10FFFF
+    ||  (code >= 0xD800 && code <= 0xDFFF)) {
+        goto bad;
+    }
+
+    *n_bytes = len;
+    return code;
+
+bad:;
+    *n_bytes = 1;
+    return 0xFFFD;
+}
+
+/* Decodes str into an array of u32 codes that is zero terminated like a string. */
+array_t get_char_codes(const char *str) {
+    array_t codes;
+    u32     code;
+    int     n_bytes;
+
+    codes = array_make(u32);
+
+    while (*str) {
+        code  = get_char_code(str, &n_bytes);
+        str  += n_bytes;
+
+        array_push(codes, code);
+    }
+
+    array_zero_term(codes);
+
+    return codes;
+}
+
+/* Writes the UTF-8 encoding of code and a NUL to out, which must have room for 5 bytes. */
+int put_char_code(char_code_t code, char *out) {
+    int n;
+
+    if (code < 0x80) {
+        out[0] = code;
+        n      = 1;
+    } else if (code < 0x800) {
+        out[0] = 0xC0 | (code >> 6);
+        out[1] = 0x80 | (code & 0x3F);
+        n      = 2;
+    } else if (code < 0x10000) {
+        out[0] = 0xE0 | (code >> 12);
+        out[1] = 0x80 | ((code >> 6) & 0x3F);
+        out[2] = 0x80 | (code & 0x3F);
+        n      = 3;
+    } else {
+        out[0] = 0xF0 | (code >> 18);
+        out[1] = 0x80 | ((code >> 12) & 0x3F);
+        out[2] = 0x80 | ((code >> 6) & 0x3F);
+        out[3] = 0x80 | (code & 0x3F);
+        n      = 4;
+    }
+
+    out[n] = 0;
+
+    return n;
+}
+
+static void get_pages_stats(array_t *pages, font_atlas_stats_t *stats) {
+    font_atlas_page_t *page;
+
+    memset(stats, 0, sizeof(*stats));
+
+    array_traverse(*pages, page) {
+        stats->n_pages      += 1;
+        stats->n_glyphs     += page->n_glyphs;
+        stats->used_pixels  += page->used_pixels;
+        stats->total_pixels += (u64)page->w * (u64)page->h;
+    }
+}
+
+void get_font_atlas_stats(font_cache_t *font, font_atlas_stats_t *stats) {
+    get_pages_stats(&font->atlas_pages, stats);
+}
+
+void get_font_atlas_budget_stats(font_atlas_budget_stats_t *stats) {
+    font_map_it        it;
+    font_master_map_it mit;
+    int                l;
+
+    memset(stats, 0, sizeof(*stats));
+
+    tree_traverse(font_map, it) {
+        stats->n_pages += array_len(tree_it_val(it).atlas_pages);
+    }
+
+    tree_traverse(font_master_map, mit) {
+        for (l = 0; l < FONT_MASTER_LEVELS; l += 1) {
+            stats->n_pages += array_len(tree_it_val(mit).atlas_pages[l]);
+        }
+    }
+
+    stats->bytes           = atlas_bytes;
+    stats->budget          = font_atlas_budget;
+    stats->evictions       = atlas_evictions;
+    stats->evicted_glyphs  = evicted_glyphs;
+    stats->restored_glyphs = restored_glyphs;
+}
+
+void print_font_atlas_stats(void) {
+    font_map_it        it;
+    font_master_map_it mit;
+    font_file_map_it   fit;
+    font_master_t     *master;
+    font_atlas_stats_t stats;
+    font_atlas_stats_t total;
+    int                l;
+    u32                n_sizes;
+    u32                n_faces;
+
+    memset(&total, 0, sizeof(total));
+
+    n_sizes = n_faces = 0;
+    tree_traverse(font_map, it)       { n_sizes += 1;                                }
+    tree_traverse(font_file_map, fit) { n_faces += tree_it_val(fit).ft_face != NULL; }
+
+    printf("[fonts] %u sizes sharing %u faces\n", n_sizes, n_faces);
+
+    tree_traverse(font_map, it) {
+        get_font_atlas_stats(&tree_it_val(it), &stats);
+
+        if (stats.n_pages == 0) { continue; }
+
+        total.n_pages      += stats.n_pages;
+        total.n_glyphs     += stats.n_glyphs;
+        total.used_pixels  += stats.used_pixels;
+        total.total_pixels += stats.total_pixels;
+
+        printf("[atlas] %s: %u glyphs in %u pages, %.1f%% occupied\n",
+               tree_it_key(it),
+               stats.n_glyphs,
+               stats.n_pages,
+               100.0 * (double)stats.used_pixels / (double)stats.total_pixels);
+    }
+
+    tree_traverse(font_master_map, mit) {
+        master = &tree_it_val(mit);
+
+        for (l = 0; l < FONT_MASTER_LEVELS; l += 1) {
+            get_pages_stats(&master->atlas_pages[l], &stats);
+
+            if (stats.n_pages == 0) { continue; }
+
+            total.n_pages      += stats.n_pages;
+            total.n_glyphs     += stats.n_glyphs;
+            total.used_pixels  += stats.used_pixels;
+            total.total_pixels += stats.total_pixels;
+
+            printf("[atlas] %s@%upx (shared): %u glyphs in %u pages, %.1f%% occupied\n",
+                   master->path,
+                   FONT_MASTER_LEVEL_PX(l),
+                   stats.n_glyphs,
+                   stats.n_pages,
+                   100.0 * (double)stats.used_pixels / (double)stats.total_pixels);
+        }
+    }
+
+    /* Pages are RGBA. */
+    printf("[atlas] total: %u glyphs in %u pages, %.1f MB of textures, %.1f MB of it glyphs, raster scale %.2f\n",
+           total.n_glyphs,
+           total.n_pages,
+           4.0 * total.total_pixels / (1024.0 * 1024.0),
+           4.0 * total.used_pixels  / (1024.0 * 1024.0),
+           font_raster_scale);
 }
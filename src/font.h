@@ -2,33 +2,195 @@
 #define __FONT_H__
 
 #include "internal.h"
+#include "array.h"
 #include "tree.h"
+#include "threadpool.h"
+#include "glyph_cache.h"
 
 typedef char        *font_name_t;
 typedef SDL_Texture *texture_ptr_t;
 typedef u64          char_code_t;
 
 typedef struct {
-    texture_ptr_t texture;    /* which texture the entry is in       */
-    u32           x, y, w, h; /* containing rectangle in the texture */
-    u32           adjust_x,
-                  adjust_y;
-    u32           pen_advance_x,
-                  pen_advance_y;
+    texture_ptr_t       texture;    /* which texture the entry is in       */
+    u32                 x, y;       /* top left of the glyph in the texture */
+    u32                 src_w,      /* size of the glyph in the texture    */
+                        src_h;
+    u32                 w, h;       /* size of the glyph when drawn        */
+    u32                 adjust_x,
+                        adjust_y;
+    u32                 pen_advance_x,
+                        pen_advance_y;
+    u32                 last_used;  /* font_frame it was last drawn in      */
+    u32                 code;
+    struct font_cache  *font;       /* NULL for shared atlas master glyphs */
 } font_entry_t;
 
+/*
+ * Glyphs are packed into atlas pages as they are first used.
+ * Each page is filled with shelves: rows of glyphs that are
+ * at most as tall as the shelf. New pages are added when a
+ * glyph doesn't fit in any of the existing ones.
+ */
+#define FONT_ATLAS_PAGE_SIZE (1024)
+
+/*
+ * Atlas pages count against font_atlas_budget bytes of textures. When a
+ * new page would go over it, the pages that were least recently drawn
+ * from are evicted. Their glyphs keep their metrics, so layout and
+ * display lists don't change, and font_restore_glyph() rasterises them
+ * again when they're next drawn. Pages drawn from in the current frame
+ * (see font_end_frame()) are never evicted, so what is on screen can
+ * exceed the budget.
+ */
+#define FONT_ATLAS_DEFAULT_BUDGET_MB (256)
+
+/*
+ * Layout always uses glyph metrics at 300 DPI in the deck's logical
+ * coordinates. Glyph images are rasterised at font_raster_scale times
+ * that size: the ratio of output pixels to logical ones, rounded up to a
+ * multiple of FONT_RASTER_SCALE_STEP. Images are drawn into the glyph's
+ * logical box, so the raster scale never changes layout.
+ */
+#define FONT_RASTER_SCALE_STEP (0.25)
+#define FONT_RASTER_SCALE_MIN  (0.25)
+#define FONT_RASTER_SCALE_MAX  (4.0)
+
+typedef struct {
+    u32 y, h; /* vertical extent of the shelf     */
+    u32 x;    /* first free column on the shelf    */
+} font_atlas_shelf_t;
+
+typedef struct {
+    texture_ptr_t texture;
+    u32           w, h;
+    u32           next_y;      /* top of the next shelf to be opened */
+    array_t       shelves;
+    u32           used_pixels; /* pixels covered by glyph bitmaps    */
+    u32           n_glyphs;
+    array_t       users;       /* font_entry_t*s drawn from the page */
+} font_atlas_page_t;
+
+typedef struct {
+    u32 n_pages;
+    u32 n_glyphs;
+    u64 used_pixels;
+    u64 total_pixels;
+} font_atlas_stats_t;
+
+typedef struct {
+    u64 bytes;           /* of atlas textures, all fonts */
+    u64 budget;
+    u32 n_pages;
+    u32 evictions;       /* of pages                     */
+    u32 evicted_glyphs;
+    u32 restored_glyphs;
+} font_atlas_budget_stats_t;
+
+/* A font file and what is known about it regardless of size. */
+#define FONT_LINE_HEIGHT_CANDIDATES (16)
+
+typedef struct {
+    char            *path;
+    unsigned char   *data;     /* the whole file, mapped                          */
+    u64              size;
+    FT_Face          ft_face;  /* shared by every size, each with its own FT_Size */
+    pthread_mutex_t  mtx;      /* held while using ft_face during a load          */
+    char_code_t      tallest[FONT_LINE_HEIGHT_CANDIDATES]; /* tallest unscaled glyphs in the first 256 codes */
+    unsigned char   *coverage; /* a bit per code the face maps, NULL until needed */
+} font_file_t;
+
+use_tree(font_name_t, font_file_t);
+typedef tree(font_name_t, font_file_t)    font_file_map_t;
+typedef tree_it(font_name_t, font_file_t) font_file_map_it;
+
+/*
+ * Glyphs are indexed by a two-level table: code >> 8 picks a page of 256
+ * entries and the low byte the entry in it. A page is allocated when the
+ * first of its glyphs is used and never moves, so entry pointers stay
+ * valid. Codes past Unicode's range are looked up as U+FFFD.
+ */
+#define FONT_GLYPH_PAGE_BITS (8)
+#define FONT_GLYPH_PAGE_SIZE (1 << FONT_GLYPH_PAGE_BITS)
+#define FONT_MAX_CHAR_CODE   (0x10FFFF)
+
+typedef struct {
+    unsigned char loaded[FONT_GLYPH_PAGE_SIZE / 8];
+    font_entry_t  entries[FONT_GLYPH_PAGE_SIZE];
+} font_glyph_page_t;
+
+/* What glyphs were indexed by before, kept for --bench-glyphs. */
 use_tree(char_code_t, font_entry_t);
 typedef tree(char_code_t, font_entry_t)    font_entry_map_t;
 typedef tree_it(char_code_t, font_entry_t) font_entry_map_it;
 
+/*
+ * Shared atlases (font_shared_atlas).
+ *
+ * Instead of every size of a font rasterising its own glyphs, each font
+ * file has one set of atlases at pixel sizes ("levels") going down from
+ * FONT_MASTER_PX in half octaves. A size draws the glyphs of the
+ * smallest level that is at least as large as itself at the raster
+ * scale, scaled down by less than sqrt(2). Levels and their glyphs are
+ * only rasterised when a size first needs them.
+ *
+ * Sizes still load their own face for hinted metrics and glyph boxes,
+ * so layout is the same as with per-size atlases and doesn't change
+ * when the raster scale moves a size to another level.
+ */
+#define FONT_MASTER_PX     (512)
+#define FONT_MASTER_LEVELS (12)
+#define FONT_MASTER_LEVEL_PX(l) \
+    ((u32)(FONT_MASTER_PX / pow(2.0, 0.5 * (l)) + 0.5))
+
 typedef struct {
-    FT_Face           ft_face;
-    texture_ptr_t     ascii_texture;
-    font_entry_t      ascii_entries[256];
-    font_entry_map_t  non_ascii_entry_map;
+    FT_Face          ft_face;
+    FT_Size          ft_size;    /* sized for cur_level                 */
+    int              cur_level;
+    array_t          atlas_pages[FONT_MASTER_LEVELS];
+    array_t          glyph_pages[FONT_MASTER_LEVELS]; /* font_glyph_page_t*, by code >> 8 */
+    glyph_cache_t   *disk[FONT_MASTER_LEVELS];
+    char            *path;
+} font_master_t;
+
+/*
+ * Kerning is asked of the face once per pair of codes, at build time,
+ * and kept in an open addressing table keyed by the pair. Layout stores
+ * the offsets it finds next to the codes (see get_kerning_offsets()),
+ * so drawing never looks them up.
+ */
+typedef struct {
+    u64 key;  /* left << 32 | right, 0 if the slot is free */
+    i32 x;
+} font_kern_pair_t;
+
+#define FONT_KERN_MIN_BITS (8)
+
+use_tree(font_name_t, font_master_t);
+typedef tree(font_name_t, font_master_t)    font_master_map_t;
+typedef tree_it(font_name_t, font_master_t) font_master_map_it;
+
+typedef struct font_cache {
+    font_master_t    *master;       /* NULL unless using a shared atlas */
+    int               master_level;
+    font_file_t      *file;
+    FT_Face           ft_face;      /* the file's, see font_face()      */
+    FT_Size           ft_size;
+    FT_Size           raster_size;  /* NULL if rasterising at ft_size   */
+    glyph_cache_t    *disk;         /* NULL unless using a glyph cache  */
+    glyph_cache_t    *raster_disk;
+    font_glyph_page_t first_page;   /* codes below 256                  */
+    array_t           glyph_pages;  /* font_glyph_page_t*, by code >> 8 */
+    array_t           atlas_pages;
     u32               line_height;
     u32               size;
     const char       *path;
+    u32               id;           /* in the order fonts were loaded   */
+    array_t           fallbacks;    /* char* paths, see font_set_fallbacks() */
+    int               has_kerning;
+    font_kern_pair_t *kern_pairs;   /* NULL until the first lookup      */
+    u32               kern_bits;    /* log2 of the table's size         */
+    u32               n_kern_pairs;
 } font_cache_t;
 
 use_tree(font_name_t, font_cache_t);
@@ -36,14 +198,39 @@ use_tree(font_name_t, font_cache_t);
 typedef tree(font_name_t, font_cache_t)    font_map_t;
 typedef tree_it(font_name_t, font_cache_t) font_map_it;
 
+typedef struct {
+    char         *key;
+    char         *name;
+    u32           size;
+    font_cache_t  cache;
+} font_preload_t;
+
 
 extern font_map_t font_map;
 extern FT_Library ft_lib;
+extern int        font_shared_atlas;
+extern float      font_raster_scale;
+extern u64        font_atlas_budget;
+extern u32        font_frame;
 
 int           init_font(void);
 font_cache_t *get_or_load_font(const char *name, u32 size, SDL_Renderer *sdl_ren);
+int           font_set_raster_scale(float scale, SDL_Renderer *sdl_ren);
+int           font_set_fallbacks(font_cache_t *font, array_t *paths);
+u64           get_font_file_data(const char *path, const unsigned char **data);
+void          font_preload(tp_t *tp, const char *name, u32 size);
+void          font_finish_preload(SDL_Renderer *sdl_ren);
 char_code_t   get_char_code(const char *str, int *n_bytes);
+array_t       get_char_codes(const char *str);
+int           put_char_code(char_code_t code, char *out);
 font_entry_t *get_glyph(font_cache_t *font, char_code_t ch, SDL_Renderer *sdl_ren);
-void          set_font_color(font_cache_t *font, int r, int g, int b);
+int           font_restore_glyph(font_entry_t *entry, SDL_Renderer *sdl_ren);
+i32           get_kerning(font_cache_t *font, char_code_t left, char_code_t right);
+array_t       get_kerning_offsets(font_cache_t *font, const u32 *codes, int len);
+void          font_end_frame(void);
+void          font_bench_glyph_lookup(const u32 *codes, int n_codes, SDL_Renderer *sdl_ren);
+void          get_font_atlas_stats(font_cache_t *font, font_atlas_stats_t *stats);
+void          get_font_atlas_budget_stats(font_atlas_budget_stats_t *stats);
+void          print_font_atlas_stats(void);
 
 #endif
@@ -0,0 +1,363 @@
+#include "glyph_cache.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+static char            *cache_dir;
+static char             ft_version[32];
+static pthread_mutex_t  caches_mtx = PTHREAD_MUTEX_INITIALIZER;
+static array_t          caches;
+static u32              hits, misses, n_written;
+
+#define PAD4(n) (((n) + 3) & ~3)
+
+static int mkdir_p(const char *path) {
+    char  buff[1024];
+    char *p;
+
+    snprintf(buff, sizeof(buff), "%s", path);
+
+    for (p = buff + 1; *p; p += 1) {
+        if (*p != '/') { continue; }
+
+        *p = 0;
+        if (mkdir(buff, 0755) != 0 && errno != EEXIST) { return 0; }
+        *p = '/';
+    }
+
+    return mkdir(buff, 0755) == 0 || errno == EEXIST;
+}
+
+/*
+ * dir may be NULL, in which case $XDG_CACHE_HOME/slide or
+ * ~/.cache/slide is used.
+ * Returns 0 if the directory can't be used.
+ */
+int glyph_cache_init(const char *dir, FT_Library lib) {
+    char  buff[1024];
+    char *base;
+    int   major, minor, patch;
+
+    if (dir != NULL) {
+        snprintf(buff, sizeof(buff), "%s", dir);
+    } else if ((base = getenv("XDG_CACHE_HOME")) && *base) {
+        snprintf(buff, sizeof(buff), "%s/slide", base);
+    } else if ((base = getenv("HOME"))) {
+        snprintf(buff, sizeof(buff), "%s/.cache/slide", base);
+    } else {
+        printf("slide: neither XDG_CACHE_HOME nor HOME are set, glyph cache disabled\n");
+        return 0;
+    }
+
+    if (!mkdir_p(buff)) {
+        printf("slide: can't create '%s', glyph cache disabled\n", buff);
+        return 0;
+    }
+
+    FT_Library_Version(lib, &major, &minor, &patch);
+    snprintf(ft_version, sizeof(ft_version), "%d.%d.%d", major, minor, patch);
+
+    caches    = array_make(glyph_cache_t*);
+    cache_dir = strdup(buff);
+
+    return 1;
+}
+
+static u64 hash_string(const char *s) {
+    u64 hash;
+
+    hash = 0xcbf29ce484222325ULL;
+
+    for (; *s; s += 1) {
+        hash ^= (unsigned char)*s;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/* Returns 0 if the file isn't a complete cache file for key. */
+static int map_file(glyph_cache_t *cache) {
+    int                         fd;
+    struct stat                 st;
+    void                       *map;
+    const glyph_cache_header_t *header;
+    u32                         i;
+    const glyph_cache_index_t  *index;
+    u64                         end;
+
+    fd = open(cache->file, O_RDONLY);
+    if (fd < 0) { return 0; }
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(*header)) {
+        close(fd);
+        return 0;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) { return 0; }
+
+    header = map;
+    index  = (void*)((char*)map + sizeof(*header) + PAD4(header->key_len));
+    end    = sizeof(*header) + PAD4((u64)header->key_len) + (u64)header->n_glyphs * sizeof(*index);
+
+    if (header->magic   != GLYPH_CACHE_MAGIC
+    ||  header->version != GLYPH_CACHE_VERSION
+    ||  end > (u64)st.st_size
+    ||  header->key_len != strlen(cache->key)
+    ||  memcmp((char*)map + sizeof(*header), cache->key, header->key_len) != 0) {
+        goto bad;
+    }
+
+    for (i = 0; i < header->n_glyphs; i += 1) {
+        if ((u64)index[i].offset + sizeof(glyph_cache_metrics_t) > (u64)st.st_size) { goto bad; }
+    }
+
+    cache->map         = map;
+    cache->map_size    = st.st_size;
+    cache->index       = index;
+    cache->n_mapped    = header->n_glyphs;
+    cache->line_height = header->line_height;
+
+    return 1;
+
+bad:;
+    munmap(map, st.st_size);
+    return 0;
+}
+
+/*
+ * Opens the cache for font_path rendered at char_size (in 1/64th
+ * points) and dpi. Opening the same one again returns the same handle,
+ * so that only one of them ever writes its file.
+ * Returns NULL if the glyph cache isn't enabled.
+ * Safe to call from several threads.
+ */
+glyph_cache_t *glyph_cache_open(const char *font_path, u32 char_size, u32 dpi) {
+    struct stat     st;
+    char            key[1280];
+    char            file[1280];
+    glyph_cache_t  *cache;
+    glyph_cache_t **it;
+
+    if (cache_dir == NULL) { return NULL; }
+
+    if (stat(font_path, &st) != 0) { return NULL; }
+
+    snprintf(key, sizeof(key), "%s\n%ld\n%ld\n%u\n%u\nfreetype %s",
+             font_path, (long)st.st_mtime, (long)st.st_size, char_size, dpi, ft_version);
+    snprintf(file, sizeof(file), "%s/%016llx.glyphs",
+             cache_dir, (unsigned long long)hash_string(key));
+
+    pthread_mutex_lock(&caches_mtx);
+
+    array_traverse(caches, it) {
+        if (strcmp((*it)->key, key) == 0) {
+            cache = *it;
+            goto out;
+        }
+    }
+
+    cache = malloc(sizeof(*cache));
+    memset(cache, 0, sizeof(*cache));
+
+    cache->file  = strdup(file);
+    cache->key   = strdup(key);
+    cache->added = array_make(glyph_cache_added_t);
+
+    map_file(cache);
+
+    array_push(caches, cache);
+
+out:;
+    pthread_mutex_unlock(&caches_mtx);
+
+    return cache;
+}
+
+/*
+ * Looks up a glyph in the file. The bitmap is w * h bytes, one row
+ * after the other.
+ */
+int glyph_cache_get(glyph_cache_t *cache, u64 code, glyph_cache_metrics_t *metrics, unsigned char **bitmap) {
+    u32                    lo, hi, mid;
+    glyph_cache_metrics_t *m;
+
+    lo = 0;
+    hi = cache->n_mapped;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+
+        if (cache->index[mid].code < code) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == cache->n_mapped || cache->index[lo].code != code) {
+        misses += 1;
+        return 0;
+    }
+
+    m = (void*)((char*)cache->map + cache->index[lo].offset);
+
+    if ((u64)cache->index[lo].offset + sizeof(*m) + (u64)m->w * m->h > cache->map_size) {
+        misses += 1;
+        return 0;
+    }
+
+    *metrics  = *m;
+    *bitmap   = (unsigned char*)(m + 1);
+    hits     += 1;
+
+    return 1;
+}
+
+void glyph_cache_add(glyph_cache_t *cache, u64 code, glyph_cache_metrics_t *metrics, const unsigned char *bitmap, int pitch) {
+    glyph_cache_added_t added;
+    u32                 i;
+
+    /* Codes that don't fit the file format are just never cached. */
+    if (code > 0xFFFFFFFF) { return; }
+
+    added.code    = code;
+    added.metrics = *metrics;
+    added.bitmap  = malloc(metrics->w * metrics->h + 1);
+
+    for (i = 0; i < metrics->h; i += 1) {
+        memcpy(added.bitmap + i * metrics->w, bitmap + i * pitch, metrics->w);
+    }
+
+    array_push(cache->added, added);
+    cache->dirty = 1;
+}
+
+void glyph_cache_set_line_height(glyph_cache_t *cache, u32 line_height) {
+    if (cache->line_height != line_height) {
+        cache->line_height = line_height;
+        cache->dirty       = 1;
+    }
+}
+
+static int cmp_record(const void *a, const void *b) {
+    u32 ca, cb;
+
+    ca = ((const glyph_cache_record_t*)a)->code;
+    cb = ((const glyph_cache_record_t*)b)->code;
+
+    return (ca > cb) - (ca < cb);
+}
+
+static void write_file(glyph_cache_t *cache) {
+    array_t               records;
+    glyph_cache_record_t  record;
+    glyph_cache_record_t *r;
+    glyph_cache_added_t  *added;
+    glyph_cache_header_t  header;
+    glyph_cache_index_t   index;
+    char                  tmp[1300];
+    char                  zeros[4];
+    FILE                 *f;
+    u32                   i;
+    u32                   offset;
+    u32                   size;
+
+    records = array_make(glyph_cache_record_t);
+
+    for (i = 0; i < cache->n_mapped; i += 1) {
+        record.code    = cache->index[i].code;
+        record.metrics = (void*)((char*)cache->map + cache->index[i].offset);
+        record.bitmap  = (unsigned char*)(record.metrics + 1);
+        array_push(records, record);
+    }
+
+    array_traverse(cache->added, added) {
+        record.code    = added->code;
+        record.metrics = &added->metrics;
+        record.bitmap  = added->bitmap;
+        array_push(records, record);
+    }
+
+    qsort(array_data(records), array_len(records), sizeof(record), cmp_record);
+
+    header.magic       = GLYPH_CACHE_MAGIC;
+    header.version     = GLYPH_CACHE_VERSION;
+    header.key_len     = strlen(cache->key);
+    header.line_height = cache->line_height;
+    header.n_glyphs    = array_len(records);
+
+    /* Write to a temporary file first so that readers never see half a file. */
+    snprintf(tmp, sizeof(tmp), "%s.%d", cache->file, getpid());
+
+    f = fopen(tmp, "wb");
+    if (f == NULL) { goto out; }
+
+    memset(zeros, 0, sizeof(zeros));
+
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(cache->key, 1, header.key_len, f);
+    fwrite(zeros, 1, PAD4(header.key_len) - header.key_len, f);
+
+    offset = sizeof(header) + PAD4(header.key_len) + header.n_glyphs * sizeof(index);
+
+    array_traverse(records, r) {
+        index.code   = r->code;
+        index.offset = offset;
+        fwrite(&index, sizeof(index), 1, f);
+
+        offset += sizeof(glyph_cache_metrics_t) + PAD4(r->metrics->w * r->metrics->h);
+    }
+
+    array_traverse(records, r) {
+        size = r->metrics->w * r->metrics->h;
+
+        fwrite(r->metrics, sizeof(glyph_cache_metrics_t), 1, f);
+        fwrite(r->bitmap, 1, size, f);
+        fwrite(zeros, 1, PAD4(size) - size, f);
+    }
+
+    if (fclose(f) != 0 || rename(tmp, cache->file) != 0) {
+        unlink(tmp);
+        goto out;
+    }
+
+    n_written += 1;
+
+out:;
+    array_free(records);
+}
+
+/*
+ * Writes out every cache that gained glyphs. The caches stay usable:
+ * mappings of the old files remain valid after they're replaced.
+ */
+void glyph_cache_save(void) {
+    glyph_cache_t **it;
+
+    if (cache_dir == NULL) { return; }
+
+    pthread_mutex_lock(&caches_mtx);
+
+    array_traverse(caches, it) {
+        if ((*it)->dirty) {
+            write_file(*it);
+            (*it)->dirty = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&caches_mtx);
+}
+
+void get_glyph_cache_stats(glyph_cache_stats_t *stats) {
+    stats->n_files   = cache_dir != NULL ? array_len(caches) : 0;
+    stats->hits      = hits;
+    stats->misses    = misses;
+    stats->n_written = n_written;
+}
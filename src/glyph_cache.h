@@ -0,0 +1,92 @@
+#ifndef __GLYPH_CACHE_H__
+#define __GLYPH_CACHE_H__
+
+#include "internal.h"
+#include "array.h"
+
+/*
+ * On-disk glyph cache.
+ *
+ * Rasterised glyphs and their metrics are kept in one file per font
+ * file and size in a cache directory, so that later runs can take them
+ * from there instead of rendering them with FreeType again. A file is
+ * keyed by the font's path, modification time and length, the size and
+ * resolution that it is rendered at and the FreeType version. A font
+ * that changes on disk simply ends up with a new file.
+ *
+ * Files are mapped read-only and bitmaps are uploaded straight from
+ * the mapping. Glyphs that had to be rendered during a run are written
+ * out, together with the ones that were already there, by
+ * glyph_cache_save().
+ *
+ * File layout (native byte order, everything 4 byte aligned):
+ *
+ *     glyph_cache_header_t
+ *     key                      (key_len bytes, padded)
+ *     glyph_cache_index_t[n]   (sorted by code)
+ *     records                  (glyph_cache_metrics_t, then w * h bytes, padded)
+ */
+
+#define GLYPH_CACHE_MAGIC   (0x48504c47) /* "GLPH" */
+#define GLYPH_CACHE_VERSION (1)
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 key_len;
+    u32 line_height; /* 0 if not known */
+    u32 n_glyphs;
+} glyph_cache_header_t;
+
+typedef struct {
+    u32 code;
+    u32 offset;      /* of the record, from the start of the file */
+} glyph_cache_index_t;
+
+typedef struct {
+    i32 adjust_x, adjust_y;
+    i32 pen_advance_x, pen_advance_y;
+    u32 w, h;
+} glyph_cache_metrics_t;
+
+typedef struct {
+    u32                    code;
+    glyph_cache_metrics_t  metrics;
+    unsigned char         *bitmap;
+} glyph_cache_added_t;
+
+/* A glyph from either the file or this run, when writing the file. */
+typedef struct {
+    u32                    code;
+    glyph_cache_metrics_t *metrics;
+    unsigned char         *bitmap;
+} glyph_cache_record_t;
+
+typedef struct {
+    char                      *file;
+    char                      *key;
+    void                      *map;
+    size_t                     map_size;
+    const glyph_cache_index_t *index;
+    u32                        n_mapped;
+    u32                        line_height;
+    int                        dirty;
+    array_t                    added;
+} glyph_cache_t;
+
+typedef struct {
+    u32 n_files;
+    u32 hits;
+    u32 misses;
+    u32 n_written;
+} glyph_cache_stats_t;
+
+int            glyph_cache_init(const char *dir, FT_Library lib);
+glyph_cache_t *glyph_cache_open(const char *font_path, u32 char_size, u32 dpi);
+int            glyph_cache_get(glyph_cache_t *cache, u64 code, glyph_cache_metrics_t *metrics, unsigned char **bitmap);
+void           glyph_cache_add(glyph_cache_t *cache, u64 code, glyph_cache_metrics_t *metrics, const unsigned char *bitmap, int pitch);
+void           glyph_cache_set_line_height(glyph_cache_t *cache, u32 line_height);
+void           glyph_cache_save(void);
+void           get_glyph_cache_stats(glyph_cache_stats_t *stats);
+
+#endif
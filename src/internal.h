@@ -8,11 +8,13 @@
 #include FT_FREETYPE_H
 #include <stdio.h>
 #include <stdint.h>
+#include <limits.h>
 #include <time.h>
 #include <assert.h>
 #include <signal.h>
 #include <unistd.h>
 #include <libgen.h>
+#include <sys/resource.h>
 
 #include <locale.h>
 #define __USE_XOPEN
@@ -64,5 +66,6 @@ fprintf(stderr, "[slide] ERROR: " __VA_ARGS__); \
 #define DEFAULT_RES_W          (1440)
 #define DEFAULT_RES_H          (1080)
 #define NON_ANIM_DRAW_INTERVAL (8)
+#define EVENT_WAIT_TIMEOUT_MS  (250)
 
 #endif
@@ -11,6 +11,9 @@ typedef struct {
     HPDF_Page                       cur_page;
     tree(font_name_t, HPDF_Font)    fonts;
     tree(image_path_t, HPDF_Image)  images;
+    font_cache_t                   *cur_font; /* set on cur_page, NULL for none */
+    int                             fill_set;
+    u32                             fill_r, fill_g, fill_b;
 } pdf_t;
 
 static void error_handler(HPDF_STATUS error_no, HPDF_STATUS detail_no, void *user_data) {
@@ -18,8 +21,10 @@ static void error_handler(HPDF_STATUS error_no, HPDF_STATUS detail_no, void *use
 }
 
 static HPDF_Font get_pdf_font(pdf_t *pdf, const char *path) {
-    const char *font_name;
-    HPDF_Font   font;
+    const unsigned char *data;
+    u64                  size;
+    const char          *font_name;
+    HPDF_Font            font;
 
     tree_it(font_name_t, HPDF_Font) it;
 
@@ -29,7 +34,8 @@ static HPDF_Font get_pdf_font(pdf_t *pdf, const char *path) {
         goto out;
     }
 
-    font_name = HPDF_LoadTTFontFromFile(pdf->doc, path, HPDF_TRUE);
+    size      = get_font_file_data(path, &data);
+    font_name = HPDF_LoadTTFontFromMem(pdf->doc, data, size, HPDF_TRUE);
     font      = HPDF_GetFont(pdf->doc, font_name, "UTF-8");
 
     tree_insert(pdf->fonts, (char*)path, font);
@@ -82,11 +88,30 @@ out:;
     return image;
 }
 
+static void pdf_fill_color(pdf_t *pdf, u32 r, u32 g, u32 b) {
+    if (pdf->fill_set
+    &&  pdf->fill_r == r
+    &&  pdf->fill_g == g
+    &&  pdf->fill_b == b) {
+        return;
+    }
+
+    HPDF_Page_SetRGBFill(pdf->cur_page, r / 255.0, g / 255.0, b / 255.0);
+
+    pdf->fill_r   = r;
+    pdf->fill_g   = g;
+    pdf->fill_b   = b;
+    pdf->fill_set = 1;
+}
+
 static void pdf_new_page(pdf_t *pdf) {
     float width;
     float ratio;
 
     pdf->cur_page = HPDF_AddPage(pdf->doc);
+    pdf->cur_font = NULL;
+    pdf->fill_set = 0;
+
     HPDF_Page_SetSize(pdf->cur_page, HPDF_PAGE_SIZE_A4, HPDF_PAGE_PORTRAIT);
 
     width = HPDF_Page_GetWidth(pdf->cur_page);
@@ -98,352 +123,86 @@ static void pdf_new_page(pdf_t *pdf) {
     HPDF_Page_SetHeight(pdf->cur_page, pdf->pres->h * ratio);
     HPDF_Page_Concat(pdf->cur_page, ratio, 0, 0, ratio, 0, 0);
 
-    HPDF_Page_SetRGBFill(pdf->cur_page, pdf->pres->r / 255.0, pdf->pres->g / 255.0, pdf->pres->b / 255.0);
+    pdf_fill_color(pdf, pdf->pres->r, pdf->pres->g, pdf->pres->b);
     HPDF_Page_Rectangle(pdf->cur_page, 0, 0, pdf->pres->w, pdf->pres->h);
     HPDF_Page_ClosePathFillStroke(pdf->cur_page);
-
-    pdf->pres->draw_y = 0;
 }
 
-static void pdf_para(pdf_t *pdf, pres_elem_t *elem) {
-    pres_t         *pres;
-    font_cache_t   *font;
-    HPDF_Font       hfont;
-    int             underline_line_height;
-    int             _x, _y;
-    array_t         wrap_points;
-    array_t         line_widths;
-    int             line;
-    int             i;
-    int             elem_start_x;
-    pres_elem_t    *eit;
-    char           *cit;
-    char            c[5] = { 0 };
-    int             wrapped;
-    char_code_t     code;
-    int             n_bytes;
-    font_entry_t   *entry;
-    int            *wrap_it;
-
-    pres = pdf->pres;
-
-    font = pres_get_elem_font(pres, elem);
-
-    underline_line_height = font->line_height;
-
-    _x = pres->draw_x + elem->l_margin;
-    _y = pres->draw_y;
-    (void)_y;
-
-    pres->draw_x  = _x;
-    pres->draw_y += font->line_height;
-
-    /* compute_para_text() */
-    wrap_points = elem->wrap_points;
-    line_widths = elem->line_widths;
-
-    line = 0;
-
-    switch (elem->justification) {
-        case JUST_L: break;
-        case JUST_R:
-            pres->draw_x += (pres->w - elem->l_margin - elem->r_margin) - *(int*)array_item(line_widths, line);
-            break;
-        case JUST_C:
-            pres->draw_x += ((pres->w - elem->l_margin - elem->r_margin) - *(int*)array_item(line_widths, line)) / 2;
-            break;
-    }
-
-    i = 0;
-
-    array_traverse(elem->para_elems, eit) {
-        font           = pres_get_elem_font(pres, eit);
-        pres->cur_font = font;
-        hfont          = get_pdf_font(pdf, font->path);
+/*
+ * Items are in slide coordinates with y going down, pages have y going
+ * up from their bottom.
+ */
 
-        HPDF_Page_SetFontAndSize(pdf->cur_page, hfont, eit->font_size * 4);
-        HPDF_Page_SetRGBFill(pdf->cur_page, eit->r / 255.0, eit->g / 255.0, eit->b / 255.0);
+static void pdf_glyph(pdf_t *pdf, pres_dl_item_t *item, int y) {
+    font_entry_t *entry;
+    char          c[5] = { 0 };
 
-        elem_start_x = pres->draw_x;
+    entry = item->entry;
 
-        array_traverse(eit->text, cit) {
-            wrapped = 0;
-
-            code  = get_char_code(cit, &n_bytes);
-            entry = get_glyph(font, code, NULL);
-
-            memcpy(c, cit, n_bytes);
-            c[n_bytes] = 0;
-
-            array_traverse(wrap_points, wrap_it) {
-                if (*wrap_it == i) {
-                    line         += 1;
-                    pres->draw_y += 1.25 * font->line_height;
-                    pres->draw_x  = _x;
-
-                    switch (elem->justification) {
-                        case JUST_L: break;
-                        case JUST_R:
-                            pres->draw_x += (pres->w - elem->l_margin - elem->r_margin) - *(int*)array_item(line_widths, line);
-                            break;
-                        case JUST_C:
-                            pres->draw_x += ((pres->w - elem->l_margin - elem->r_margin) - *(int*)array_item(line_widths, line)) / 2;
-                            break;
-                    }
-
-                    elem_start_x = pres->draw_x;
-
-                    wrapped = 1;
-                    break;
-                }
-            }
-
-            HPDF_Page_BeginText(pdf->cur_page);
-            HPDF_Page_SetTextRenderingMode(pdf->cur_page, HPDF_FILL);
-            HPDF_Page_TextOut(pdf->cur_page, pres->draw_x, pres->h - pres->draw_y, c);
-            HPDF_Page_EndText(pdf->cur_page);
-
-            if (eit->flags & PRES_UNDERLINE) {
-                HPDF_Page_SetRGBStroke(pdf->cur_page, eit->r / 255.0, eit->g / 255.0, eit->b / 255.0);
-                HPDF_Page_SetRGBFill(pdf->cur_page, eit->r / 255.0, eit->g / 255.0, eit->b / 255.0);
-                HPDF_Page_Rectangle(pdf->cur_page,
-                                    elem_start_x,
-                                    pres->h - pres->draw_y - 0.025 * underline_line_height,
-                                    pres->draw_x - elem_start_x + entry->pen_advance_x,
-                                    0.025 * underline_line_height);
-                HPDF_Page_ClosePathFillStroke(pdf->cur_page);
-            }
-
-            if (!wrapped) {
-                pres->draw_x += entry->pen_advance_x;
-            }
-            pres->draw_y += entry->pen_advance_y;
-
-            /* Update our iterator if this was a unicode multibyte sequence. */
-            cit += n_bytes - 1;
-            i   += n_bytes;
-        }
+    /* Each glyph is drawn with the font it came from, fallbacks included. */
+    if (entry->font != pdf->cur_font) {
+        HPDF_Page_SetFontAndSize(pdf->cur_page,
+                                 get_pdf_font(pdf, entry->font->path),
+                                 entry->font->size * 4);
+        pdf->cur_font = entry->font;
     }
 
-/*     HPDF_Page_EndText(pdf->cur_page); */
-
-    pres->is_translating = 0;
-}
+    pdf_fill_color(pdf, item->r, item->g, item->b);
 
-static void pdf_string(pdf_t *pdf, const char *str, int l_margin, int r_margin, int justification) {
-    pres_t         *pres;
-    int             _x, _y;
-    int             len;
-    int             i;
-    font_entry_t   *entry;
-    array_t         wrap_points;
-    array_t         line_widths;
-    int            *wrap_it;
-    int             wrapped;
-    unsigned char  *bytes;
-    char_code_t     code;
-    int             n_bytes;
-    int             line;
-    font_cache_t   *font;
-    HPDF_Font       hfont;
-    char            c[5] = { 0 };
-
-    if (!str) { return; }
-
-    pres = pdf->pres;
-
-    font = pres->cur_font;
-    if (!font) { return; }
+    put_char_code(entry->code, c);
 
+    /*
+     * A text object per glyph keeps the positions absolute, rather than
+     * relative to the previous glyph's in floating point.
+     */
     HPDF_Page_BeginText(pdf->cur_page);
     HPDF_Page_SetTextRenderingMode(pdf->cur_page, HPDF_FILL);
-
-    hfont = get_pdf_font(pdf, font->path);
-    HPDF_Page_SetFontAndSize(pdf->cur_page, hfont, pres->cur_font->size * 4);
-
-    _x = pres->draw_x + l_margin;
-    _y = pres->draw_y;
-
-    (void)_y;
-
-    pres->draw_x  = _x;
-    pres->draw_y += font->line_height;
-
-    bytes = (unsigned char*)str;
-
-    len = strlen(str);
-
-    wrap_points = get_wrap_points(pres, bytes, l_margin, r_margin, &line_widths);
-    line        = 0;
-
-    switch (justification) {
-        case JUST_L: break;
-        case JUST_R:
-            pres->draw_x += (pres->w - l_margin - r_margin) - *(int*)array_item(line_widths, line);
-            break;
-        case JUST_C:
-            pres->draw_x += ((pres->w - l_margin - r_margin) - *(int*)array_item(line_widths, line)) / 2;
-            break;
-    }
-
-    for (i = 0; i < len;) {
-        wrapped = 0;
-
-        code  = get_char_code(str + i, &n_bytes);
-        entry = get_glyph(font, code, NULL);
-
-        memcpy(c, str + i, n_bytes);
-        c[n_bytes] = 0;
-
-        array_traverse(wrap_points, wrap_it) {
-            if (*wrap_it == i) {
-                line   += 1;
-                pres->draw_y += 1.25 * font->line_height;
-                pres->draw_x  = _x;
-
-                switch (justification) {
-                    case JUST_L: break;
-                    case JUST_R:
-                        pres->draw_x += (pres->w - l_margin - r_margin) - *(int*)array_item(line_widths, line);
-                        break;
-                    case JUST_C:
-                        pres->draw_x += ((pres->w - l_margin - r_margin) - *(int*)array_item(line_widths, line)) / 2;
-                        break;
-                }
-
-                wrapped = 1;
-                break;
-            }
-        }
-
-        HPDF_Page_TextOut(pdf->cur_page, pres->draw_x, pres->h - pres->draw_y, c);
-
-        if (!wrapped) {
-            pres->draw_x += entry->pen_advance_x;
-        }
-        pres->draw_y += entry->pen_advance_y;
-
-        i += n_bytes;
-    }
-
-    array_free(line_widths);
-    array_free(wrap_points);
-
-
+    HPDF_Page_TextOut(pdf->cur_page, item->x, (int)pdf->pres->h - y, c);
     HPDF_Page_EndText(pdf->cur_page);
 }
 
-static void pdf_bullet(pdf_t *pdf, pres_elem_t *elem) {
-    int save_draw_x,
-        save_draw_y;
-    int new_l_margin;
-    int save_l_margin;
-
-    pdf->pres->cur_font = pres_get_elem_font(pdf->pres, elem);
-
-    HPDF_Page_SetRGBFill(pdf->cur_page, elem->r / 255.0, elem->g / 255.0, elem->b / 255.0);
-
-    save_draw_x = pdf->pres->draw_x;
-    save_draw_y = pdf->pres->draw_y;
-
-    new_l_margin =   elem->l_margin
-                   + ((0.05 * (elem->level - 1)) * pdf->pres->w);
-
-    pdf_string(pdf,
-               pdf->pres->bullet_strings[elem->level - 1],
-               new_l_margin, elem->r_margin, JUST_L);
-
-    new_l_margin = pdf->pres->draw_x - save_draw_x;
-    pdf->pres->draw_x = save_draw_x;
-    pdf->pres->draw_y = save_draw_y;
-
-    save_l_margin  = elem->l_margin;
-    elem->l_margin = new_l_margin;
-    pdf_para(pdf, elem);
-    elem->l_margin = save_l_margin;
+static void pdf_rect(pdf_t *pdf, pres_dl_item_t *item, int y) {
+    pdf_fill_color(pdf, item->r, item->g, item->b);
 
-    pdf->pres->is_translating = 0;
+    HPDF_Page_Rectangle(pdf->cur_page, item->x, (int)pdf->pres->h - y - item->h, item->w, item->h);
+    HPDF_Page_Fill(pdf->cur_page);
 }
 
-static void pdf_break(pdf_t *pdf, pres_elem_t *elem) {
-    if (pdf->pres->cur_font) {
-        pdf->pres->draw_y += 0.75 * pdf->pres->cur_font->line_height;
-    }
-    pdf->pres->is_translating = 0;
-}
-
-static void pdf_vspace(pdf_t *pdf, pres_elem_t *elem) {
-    pdf->pres->draw_y += elem->y;
-    pdf->pres->is_translating = 0;
-}
-
-static void pdf_vfill(pdf_t *pdf, pres_elem_t *elem) {
-    pdf->pres->draw_y += pdf->pres->h - (pdf->pres->draw_y % pdf->pres->h);
-    pdf->pres->is_translating = 0;
-}
-
-static void pdf_image(pdf_t *pdf, pres_elem_t *elem) {
-    HPDF_Image image;
-
-    image = get_image(pdf, elem->image);
-
+static void pdf_image(pdf_t *pdf, pres_dl_item_t *item, int y) {
     HPDF_Page_DrawImage(pdf->cur_page,
-                        image,
-                        pdf->pres->draw_x, pdf->pres->h - pdf->pres->draw_y - elem->h, elem->w, elem->h);
-
-    pdf->pres->draw_y         += elem->h;
-    pdf->pres->is_translating  = 0;
-}
-
-static void pdf_save(pdf_t *pdf, pres_elem_t *elem) {
-    mark_name_t key;
-    mark_map_it it;
-
-    key = elem->mark_name;
-
-    it = tree_lookup(pdf->pres->marks, elem->mark_name);
-    if (!tree_it_good(it)) { key = strdup(key); }
-
-    tree_insert(pdf->pres->marks, key, pdf->pres->draw_y);
+                        get_image(pdf, item->image),
+                        item->x, (int)pdf->pres->h - y - item->h, item->w, item->h);
 }
 
-static void pdf_restore(pdf_t *pdf, pres_elem_t *elem) {
-    mark_map_it it;
-    int         dst;
+/*
+ * Whether any of the item is on the page whose top is at top. Ranges can
+ * cross slide boundaries, and what's past the page would only be clipped.
+ */
+static int item_on_page(pdf_t *pdf, pres_dl_item_t *item, int top) {
+    int y;
 
-    dst = 0;
-    it  = tree_lookup(pdf->pres->marks, elem->mark_name);
-    if (tree_it_good(it)) {
-        dst = tree_it_val(it);
+    y = item->y;
+    if (item->kind == PRES_DL_GLYPH) {
+        y -= (int)item->entry->adjust_y;
     }
 
-    pdf->pres->draw_y = dst;
-}
-
-static void pdf_goto(pdf_t *pdf, pres_elem_t *elem) {
-    pdf->pres->is_translating = 1;
-    pdf->pres->draw_x = elem->x;
-    pdf->pres->draw_y = pdf->pres->draw_y - (pdf->pres->draw_y % pdf->pres->h) + elem->y;
-}
-
-static void pdf_gotox(pdf_t *pdf, pres_elem_t *elem) {
-    pdf->pres->is_translating = 1;
-    pdf->pres->draw_x = pdf->pres->view_x + elem->x;
-}
-
-static void pdf_gotoy(pdf_t *pdf, pres_elem_t *elem) {
-    pdf->pres->draw_y = pdf->pres->draw_y - (pdf->pres->draw_y % pdf->pres->h) + elem->y;
-}
-
-static void pdf_translate(pdf_t *pdf, pres_elem_t *elem) {
-    pdf->pres->is_translating  = 1;
-    pdf->pres->draw_x         += elem->x;
-    pdf->pres->draw_y         += elem->y;
+    return y + (int)item->h > top && y < top + (int)pdf->pres->h;
 }
 
+/*
+ * The layout is the renderer's: every slide of the compiled display list
+ * becomes a page, so both put everything in the same place.
+ */
 void export_to_pdf(pres_t *pres, const char *path) {
-    pdf_t        pdf;
-    pres_elem_t *elem;
+    pdf_t            pdf;
+    int              slide;
+    int              top;
+    int             *idx;
+    pres_dl_range_t *range;
+    pres_dl_item_t  *item;
+    int              i;
+
+    memset(&pdf, 0, sizeof(pdf));
 
     pdf.pres   = pres;
     pdf.fonts  = tree_make_c(font_name_t, HPDF_Font, strcmp);
@@ -458,27 +217,28 @@ void export_to_pdf(pres_t *pres, const char *path) {
     HPDF_SetPageMode(pdf.doc, HPDF_PAGE_MODE_USE_THUMBS);
     HPDF_UseUTFEncodings(pdf.doc);
 
-    pdf_new_page(&pdf);
-
-    array_traverse(pres->elements, elem) {
-        switch (elem->kind) {
-            case PRES_PARA:      pdf_para(&pdf, elem);      break;
-            case PRES_BULLET:    pdf_bullet(&pdf, elem);    break;
-            case PRES_BREAK:     pdf_break(&pdf, elem);     break;
-            case PRES_VSPACE:    pdf_vspace(&pdf, elem);    break;
-            case PRES_VFILL:     pdf_vfill(&pdf, elem);     break;
-            case PRES_IMAGE:     pdf_image(&pdf, elem);     break;
-            case PRES_SAVE:      pdf_save(&pdf, elem);      break;
-            case PRES_RESTORE:   pdf_restore(&pdf, elem);   break;
-            case PRES_GOTO:      pdf_goto(&pdf, elem);      break;
-            case PRES_GOTOX:     pdf_gotox(&pdf, elem);     break;
-            case PRES_GOTOY:     pdf_gotoy(&pdf, elem);     break;
-            case PRES_TRANSLATE: pdf_translate(&pdf, elem); break;
-            case PRES_POINT:
-                if (pres->draw_y >= pres->h) { pdf_new_page(&pdf); }
-        }
+    for (slide = 0; slide < pres_n_slides(pres); slide += 1) {
+        pdf_new_page(&pdf);
+
+        top = slide * (int)pres->h;
+
+        pres_query_slide(pres, slide);
+
+        array_traverse(pres->view_visible, idx) {
+            range = array_item(pres->dl_elem_ranges, *idx);
 
-        if (!pres->is_translating) { pres->draw_x = 0; }
+            for (i = range->start; i < range->end; i += 1) {
+                item = array_item(pres->dl_items, i);
+
+                if (!item_on_page(&pdf, item, top)) { continue; }
+
+                switch (item->kind) {
+                    case PRES_DL_GLYPH: pdf_glyph(&pdf, item, item->y - top); break;
+                    case PRES_DL_RECT:  pdf_rect(&pdf, item, item->y - top);  break;
+                    case PRES_DL_IMAGE: pdf_image(&pdf, item, item->y - top); break;
+                }
+            }
+        }
     }
 
     HPDF_SaveToFile(pdf.doc, path);
@@ -187,15 +187,25 @@ static u32 get_or_add_font_by_id(pres_t *pres, char *font) {
     return array_len(pres->fonts) - 1;
 }
 
+/*
+ * The font is looked up by name and size the first time an element
+ * asks for it and kept on the element after that. compute_text()
+ * resolves the fonts of all text, so later passes don't look anything up.
+ */
 font_cache_t * pres_get_elem_font(pres_t *pres, pres_elem_t *elem) {
-    u32 which;
-    i32 id;
+    u32           which;
+    i32           id;
+    font_cache_t *font;
 
     which = 0;
 
     which += 1 * !!(elem->flags & PRES_BOLD);
     which += 2 * !!(elem->flags & PRES_ITALIC);
 
+    font = elem->fonts[which];
+
+    if (likely(font != NULL)) { return font; }
+
     switch (which) {
         case 0:  id = elem->font_id;             break;
         case 1:  id = elem->font_bold_id;        break;
@@ -208,9 +218,17 @@ font_cache_t * pres_get_elem_font(pres_t *pres, pres_elem_t *elem) {
         ERR("no font(s) set!\n");
     }
 
-    return get_or_load_font(
+    font = get_or_load_font(
                 pres_get_font_name_by_id(pres, id),
                 elem->font_size, pres->sdl_ren);
+
+    if (font_set_fallbacks(font, &pres->fallback_fonts)) {
+        pres->glyphs_reloaded = 1;
+    }
+
+    elem->fonts[which] = font;
+
+    return font;
 }
 
 typedef struct {
@@ -491,6 +509,27 @@ DEF_CMD(font_bold_italic) {
     free(rel_path);
 }
 
+/*
+ * Adds a font to the chain that codes missing from a font are taken
+ * from, for the whole deck.
+ */
+DEF_CMD(font_fallback) {
+    char  *rel_path;
+    char **it;
+
+    GET_S(1);
+    rel_path = get_pres_path(pres, S);
+
+    array_traverse(pres->fallback_fonts, it) {
+        if (strcmp(*it, rel_path) == 0) {
+            free(rel_path);
+            return;
+        }
+    }
+
+    array_push(pres->fallback_fonts, rel_path);
+}
+
 DEF_CMD(size) {
     GET_I(1);
     ctx->font_size = I >= 0 ? I : 0 - I;
@@ -675,6 +714,7 @@ static image_path_t ensure_image(pres_t *pres, build_ctx_t *ctx, const char *pat
     }
 
     image_data.image_data = image_data.texture = NULL;
+    image_data.prefetched = 0;
     it = tree_insert(pres->images, strdup(path), image_data);
 
     payload      = malloc(sizeof(*payload));
@@ -783,6 +823,7 @@ do {                              \
     else if (strcmp(cmd, "font-bold")        == 0) { CALL_CMD(font_bold);         }
     else if (strcmp(cmd, "font-italic")      == 0) { CALL_CMD(font_italic);       }
     else if (strcmp(cmd, "font-bold-italic") == 0) { CALL_CMD(font_bold_italic);  }
+    else if (strcmp(cmd, "font-fallback")    == 0) { CALL_CMD(font_fallback);     }
     else if (strcmp(cmd, "size")             == 0) { CALL_CMD(size);              }
     else if (strcmp(cmd, "bold")             == 0) { CALL_CMD(bold);              }
     else if (strcmp(cmd, "no-bold")          == 0) { CALL_CMD(no_bold);           }
@@ -843,10 +884,13 @@ static int pres_get_ctx_font_id(pres_t *pres, build_ctx_t *ctx) {
 
 static void do_para(pres_t *pres, build_ctx_t *ctx, char *line, int line_len) {
     pres_elem_t elem;
+    int         font_id;
+
+    font_id = pres_get_ctx_font_id(pres, ctx);
 
     if (ctx->elem.kind != PRES_PARA
     &&  ctx->elem.kind != PRES_BULLET) {
-        if (pres_get_ctx_font_id(pres, ctx) == -1) {
+        if (font_id == -1) {
             BUILD_ERR("text present, but no font is set\n");
         }
         commit_element(pres, ctx);
@@ -865,6 +909,11 @@ static void do_para(pres_t *pres, build_ctx_t *ctx, char *line, int line_len) {
     format_elem(ctx, &elem);
     array_push(ctx->elem.para_elems, elem);
 
+    /* Load the font on the pool while the rest of the file is parsed. */
+    if (font_id != -1) {
+        font_preload(ctx->tp, pres_get_font_name_by_id(pres, font_id), ctx->font_size);
+    }
+
     if (array_len(ctx->elem.para_elems) == 1) {
         format_elem(ctx, &ctx->elem);
     }
@@ -1004,6 +1053,9 @@ pres_image_data_t *pres_get_image_data(pres_t *pres, const char *image) {
 
         if (image_data->texture == NULL && pres->sdl_ren) {
             pres_create_image_texture(pres, image_data);
+        } else if (image_data->prefetched) {
+            image_data->prefetched  = 0;
+            pres->n_prefetch_used  += 1;
         }
 
         return image_data;
@@ -1024,61 +1076,60 @@ sdl_texture_t pres_get_image_texture(pres_t *pres, const char *image) {
     return NULL;
 }
 
-array_t get_wrap_points(pres_t *pres, const unsigned char *bytes, int l_margin, int r_margin, array_t *line_widths) {
-    int           len;
-    array_t       wrap_points;
+/*
+ * Breaks the codes into lines that fit between the margins, at spaces.
+ * Returns an array of pres_line_t.
+ */
+array_t get_text_lines(pres_t *pres, const u32 *codes, const i32 *kerns, int len, int l_margin, int r_margin, int justification) {
+    array_t       lines;
+    pres_line_t   line;
     int           total_width;
     int           line_width;
     int           i, j;
     int           last_space;
     font_entry_t *entry;
-    char_code_t   code;
-    int           n_bytes_i, n_bytes_j;
     int           space_width;
     font_cache_t *font;
 
     font = pres->cur_font;
 
-    code         = get_char_code(" ", &n_bytes_i);
-    entry        = get_glyph(font, code, pres->sdl_ren);
+    entry        = get_glyph(font, ' ', pres->sdl_ren);
     space_width  = entry->pen_advance_x;
 
-    len = strlen((const char *)bytes);
-
-    wrap_points  = array_make(int);
-    *line_widths = array_make(int);
+    lines        = array_make(pres_line_t);
+    line.start   = 0;
+    line.x       = 0;
     total_width  = l_margin;
     last_space   = -1;
 
-    for (i = 0; i < len;) {
-        code  = get_char_code(((const char *)bytes) + i, &n_bytes_i);
-        entry = get_glyph(font, code, pres->sdl_ren);
+    for (i = 0; i < len; i += 1) {
+        entry = get_glyph(font, codes[i], pres->sdl_ren);
 
-        total_width += entry->pen_advance_x;
+        total_width += entry->pen_advance_x + kerns[i];
 
         if (total_width > pres->w - r_margin) {
             line_width  = total_width;
             total_width = l_margin;
 
             if (last_space != -1) {
-                for (j = last_space + 1; j <= i;) {
-                    code         = get_char_code(((const char *)bytes) + j, &n_bytes_j);
-                    entry        = get_glyph(font, code, pres->sdl_ren);
-                    total_width += entry->pen_advance_x;
-                    j += n_bytes_j;
+                for (j = last_space + 1; j <= i; j += 1) {
+                    entry        = get_glyph(font, codes[j], pres->sdl_ren);
+                    total_width += entry->pen_advance_x + kerns[j];
                 }
 
                 line_width -= total_width;
                 line_width -= space_width;
-                array_push(*line_widths, line_width);
-                array_push(wrap_points, last_space);
+
+                line.end   = last_space + 1;
+                line.width = line_width;
+                array_push(lines, line);
+
+                line.start = last_space + 1;
                 last_space = -1;
             }
         }
 
-        if (isspace(bytes[i])) { last_space = i; }
-
-        i += n_bytes_i;
+        if (codes[i] < 128 && isspace(codes[i])) { last_space = i; }
     }
 
     if (total_width > pres->w - r_margin) {
@@ -1086,63 +1137,132 @@ array_t get_wrap_points(pres_t *pres, const unsigned char *bytes, int l_margin,
         total_width = l_margin;
 
         if (last_space != -1) {
+            /* codes and kerns are zero terminated, so [len] is fine here. */
             for (j = last_space + 1; j <= i; j += 1) {
-                entry        = get_glyph(font, bytes[j], pres->sdl_ren);
-                total_width += entry->pen_advance_x;
+                entry        = get_glyph(font, codes[j], pres->sdl_ren);
+                total_width += entry->pen_advance_x + kerns[j];
             }
 
             line_width -= total_width;
-            array_push(*line_widths, line_width);
-            array_push(wrap_points, last_space);
+
+            line.end   = last_space + 1;
+            line.width = line_width;
+            array_push(lines, line);
+
+            line.start = last_space + 1;
         }
     }
 
-    line_width = total_width - l_margin;
-    array_push(*line_widths, line_width);
+    line.end   = len;
+    line.width = total_width - l_margin;
+    array_push(lines, line);
 
-    return wrap_points;
+    justify_text_lines(pres, lines, l_margin, r_margin, justification);
+
+    return lines;
 }
 
-static void compute_para_text(pres_t *pres, pres_elem_t *elem) {
-    pres_elem_t *eit;
+/* Sets where each line starts for text between the margins. */
+void justify_text_lines(pres_t *pres, array_t lines, int l_margin, int r_margin, int justification) {
+    pres_line_t *line;
 
-    elem->all_text = array_make(char);
+    array_traverse(lines, line) {
+        switch (justification) {
+            case JUST_L:
+                line->x = 0;
+                break;
+            case JUST_R:
+                line->x = (pres->w - l_margin - r_margin) - line->width;
+                break;
+            case JUST_C:
+                line->x = ((pres->w - l_margin - r_margin) - line->width) / 2;
+                break;
+        }
+    }
+}
+
+/*
+ * Decodes the text of every element in the paragraph, resolves its font
+ * and looks up its kerning once, so that wrapping, compiling and the PDF
+ * export don't have to. Glyphs aren't kerned across elements, since
+ * those change the font.
+ */
+static void prepare_para_text(pres_t *pres, pres_elem_t *elem) {
+    pres_elem_t  *eit;
+    font_cache_t *font;
+
+    elem->all_codes = array_make(u32);
+    elem->all_kerns = array_make(i32);
     array_traverse(elem->para_elems, eit) {
-        array_push_n(elem->all_text,
-                     array_data(eit->text),
-                     array_len(eit->text));
+        eit->codes = get_char_codes(array_data(eit->text));
+        array_push_n(elem->all_codes,
+                     array_data(eit->codes),
+                     array_len(eit->codes));
+
+        font       = pres_get_elem_font(pres, eit);
+        eit->kerns = get_kerning_offsets(font, array_data(eit->codes), array_len(eit->codes));
+        array_push_n(elem->all_kerns,
+                     array_data(eit->kerns),
+                     array_len(eit->kerns));
     }
-    array_zero_term(elem->all_text);
+    array_zero_term(elem->all_codes);
+    array_zero_term(elem->all_kerns);
+}
+
+static void compute_para_text(pres_t *pres, pres_elem_t *elem) {
+    prepare_para_text(pres, elem);
 
     pres->cur_font = pres_get_elem_font(pres, elem);
 
-    elem->wrap_points = get_wrap_points(pres,
-                                        array_data(elem->all_text),
-                                        elem->l_margin, elem->r_margin,
-                                        &elem->line_widths);
+    elem->lines = get_text_lines(pres,
+                                 array_data(elem->all_codes),
+                                 array_data(elem->all_kerns),
+                                 array_len(elem->all_codes),
+                                 elem->l_margin, elem->r_margin,
+                                 elem->justification);
 }
 
 static void compute_bullet_text(pres_t *pres, pres_elem_t *elem) {
-    pres_elem_t *eit;
     int          new_l_margin;
+    array_t      bullet_codes;
+    array_t      bullet_kerns;
+    array_t      bullet_lines;
+    pres_line_t *last;
 
-    elem->all_text = array_make(char);
-    array_traverse(elem->para_elems, eit) {
-        array_push_n(elem->all_text,
-                     array_data(eit->text),
-                     array_len(eit->text));
-    }
-    array_zero_term(elem->all_text);
+    prepare_para_text(pres, elem);
 
     pres->cur_font = pres_get_elem_font(pres, elem);
 
     new_l_margin =   elem->l_margin
                    + ((0.05 * (elem->level - 1)) * pres->w);
 
-    elem->wrap_points = get_wrap_points(pres,
-                                        array_data(elem->all_text),
-                                        new_l_margin, elem->r_margin,
-                                        &elem->line_widths);
+    elem->lines = get_text_lines(pres,
+                                 array_data(elem->all_codes),
+                                 array_data(elem->all_kerns),
+                                 array_len(elem->all_codes),
+                                 new_l_margin, elem->r_margin,
+                                 JUST_L);
+
+    /*
+     * The text is wrapped at the bullet's indentation, but justified
+     * after the bullet string, where compile_bullet() starts it.
+     */
+    bullet_codes = get_char_codes(pres->bullet_strings[elem->level - 1]);
+    bullet_kerns = get_kerning_offsets(pres->cur_font, array_data(bullet_codes), array_len(bullet_codes));
+    bullet_lines = get_text_lines(pres,
+                                  array_data(bullet_codes),
+                                  array_data(bullet_kerns),
+                                  array_len(bullet_codes),
+                                  new_l_margin, elem->r_margin,
+                                  JUST_L);
+
+    last = array_last(bullet_lines);
+
+    justify_text_lines(pres, elem->lines, new_l_margin + last->width, elem->r_margin, elem->justification);
+
+    array_free(bullet_lines);
+    array_free(bullet_kerns);
+    array_free(bullet_codes);
 }
 
 static void compute_text(pres_t *pres) {
@@ -1158,6 +1278,8 @@ static void compute_text(pres_t *pres) {
     }
 }
 
+static void compile_display_list(pres_t *pres);
+
 static char * get_pres_dir_str(const char *path) {
     char buff[1024];
 
@@ -1180,7 +1302,14 @@ pres_t build_presentation(const char *path, SDL_Renderer *sdl_ren) {
 
     pres.sdl_ren         = sdl_ren;
     pres.elements        = array_make(pres_elem_t);
+    pres.dl_items        = array_make(pres_dl_item_t);
+    pres.dl_ranges       = array_make(pres_dl_range_t);
+    pres.dl_elem_ranges  = array_make(pres_dl_range_t);
+    pres.view_index      = array_make(array_t);
+    pres.view_visible    = array_make(int);
+    pres.slide_hashes    = array_make(u64);
     pres.fonts           = array_make(char*);
+    pres.fallback_fonts  = array_make(char*);
     pres.macros          = tree_make_c(macro_name_t, array_t, strcmp);
     pres.collect_macro   = NULL;
     pres.beg_end_match   = 0;
@@ -1221,10 +1350,18 @@ pres_t build_presentation(const char *path, SDL_Renderer *sdl_ren) {
         ERR("could not open presentation file '%s'\n", path);
     }
 
+    TIME_ON(font_finish_preload) {
+        font_finish_preload(sdl_ren);
+    } TIME_OFF(font_finish_preload);
+
     TIME_ON(compute_text) {
         compute_text(&pres);
     } TIME_OFF(compute_text);
 
+    TIME_ON(compile_display_list) {
+        compile_display_list(&pres);
+    } TIME_OFF(compile_display_list);
+
     tp_wait(ctx.tp);
     tp_stop(ctx.tp, TP_GRACEFUL);
     tp_free(ctx.tp);
@@ -1240,6 +1377,7 @@ void free_presentation(pres_t *pres) {
     char             **fit;
     pres_elem_t       *eit1,
                       *eit2;
+    array_t           *bucket;
 
     array_free(pres->macro_use_stack);
 
@@ -1267,21 +1405,33 @@ void free_presentation(pres_t *pres) {
 
     array_traverse(pres->fonts, fit) { free(*fit); }
     array_free(pres->fonts);
+    array_traverse(pres->fallback_fonts, fit) { free(*fit); }
+    array_free(pres->fallback_fonts);
 
     array_traverse(pres->elements, eit1) {
         if (eit1->kind == PRES_PARA
         ||  eit1->kind == PRES_BULLET) {
             array_traverse(eit1->para_elems, eit2) {
                 array_free(eit2->text);
+                array_free(eit2->codes);
+                array_free(eit2->kerns);
             }
             array_free(eit1->para_elems);
-            array_free(eit1->all_text);
-            array_free(eit1->wrap_points);
-            array_free(eit1->line_widths);
+            array_free(eit1->all_codes);
+            array_free(eit1->all_kerns);
+            array_free(eit1->lines);
         }
     }
     array_free(pres->elements);
 
+    array_free(pres->dl_items);
+    array_free(pres->dl_ranges);
+    array_free(pres->dl_elem_ranges);
+    array_traverse(pres->view_index, bucket) { array_free(*bucket); }
+    array_free(pres->view_index);
+    array_free(pres->view_visible);
+    array_free(pres->slide_hashes);
+
     free(pres->pres_dir);
 
     pthread_mutex_destroy(&pres->err_mtx);
@@ -1309,7 +1459,7 @@ void pres_clear_and_draw_bg(pres_t *pres) {
                            pres->b,
                            255);
 
-    SDL_RenderFillRect(pres->sdl_ren, &r);
+    batch_fill_rect(pres->sdl_ren, &r);
 
     SDL_SetRenderDrawColor(pres->sdl_ren,
                            255 - pres->r,
@@ -1318,24 +1468,102 @@ void pres_clear_and_draw_bg(pres_t *pres) {
                            255);
 }
 
-#define IN_VIEW(pres) \
-((pres)->draw_y > -((pres)->h) || (pres)->draw_y < ((pres)->max_view_slides * (pres)->h))
+/*
+ * Display list compilation.
+ *
+ * The layout state machine (draw_x/draw_y, goto, translate, save/restore,
+ * vfill, ...) runs once after compute_text() and records positioned glyphs,
+ * rectangles and images in slide coordinates (view_y == 0). Every point
+ * gets its own range of items along with the vertical extent they cover.
+ * Drawing a frame only replays the ranges that are in view, offset by the
+ * current view.
+ */
+
+static pres_dl_range_t cur_elem_range;
+
+static void dl_range_extend(pres_dl_range_t *range, int end, int top, int bottom) {
+    range->end = end;
+
+    if (top    < range->y0) { range->y0 = top;    }
+    if (bottom > range->y1) { range->y1 = bottom; }
+}
+
+static void dl_range_init(pres_dl_range_t *range, int start) {
+    range->start = range->end = start;
+    range->y0    = INT_MAX;
+    range->y1    = INT_MIN;
+    range->stamp = 0;
+}
+
+static void dl_emit(pres_t *pres, pres_dl_item_t *item, int top, int bottom) {
+    array_push(pres->dl_items, *item);
+
+    dl_range_extend(array_last(pres->dl_ranges), array_len(pres->dl_items), top, bottom);
+    dl_range_extend(&cur_elem_range,             array_len(pres->dl_items), top, bottom);
+}
+
+static void dl_glyph(pres_t *pres, font_entry_t *entry, int x, int y, u32 r, u32 g, u32 b) {
+    pres_dl_item_t item;
+    int            top;
+
+    item.kind  = PRES_DL_GLYPH;
+    item.x     = x;
+    item.y     = y;
+    item.w     = entry->w;
+    item.h     = entry->h;
+    item.r     = r;
+    item.g     = g;
+    item.b     = b;
+    item.entry = entry;
+
+    top = y - (int)entry->adjust_y;
+
+    dl_emit(pres, &item, top, top + (int)entry->h);
+}
+
+static void dl_rect(pres_t *pres, int x, int y, int w, int h, u32 r, u32 g, u32 b) {
+    pres_dl_item_t item;
+
+    item.kind  = PRES_DL_RECT;
+    item.x     = x;
+    item.y     = y;
+    item.w     = w;
+    item.h     = h;
+    item.r     = r;
+    item.g     = g;
+    item.b     = b;
+    item.image = NULL;
+
+    dl_emit(pres, &item, y, y + h);
+}
 
-void draw_string(pres_t *pres, const char *str, int l_margin, int r_margin, int justification) {
+static void dl_image(pres_t *pres, char *image, int x, int y, int w, int h) {
+    pres_dl_item_t item;
+
+    item.kind  = PRES_DL_IMAGE;
+    item.x     = x;
+    item.y     = y;
+    item.w     = w;
+    item.h     = h;
+    item.r     = item.g = item.b = 255;
+    item.image = image;
+
+    dl_emit(pres, &item, y, y + h);
+}
+
+static void compile_string(pres_t *pres, const char *str, int l_margin, int r_margin, int justification, u32 r, u32 g, u32 b) {
     int            _x, _y;
     int            len;
     int            i;
     font_entry_t  *entry;
-    SDL_Rect       srect,
-                   drect;
-    array_t        wrap_points;
-    array_t        line_widths;
-    int           *wrap_it;
+    int            glyph_x, glyph_y;
+    array_t        lines;
+    pres_line_t   *line;
+    pres_line_t   *last_line;
     int            wrapped;
-    unsigned char *bytes;
-    char_code_t    code;
-    int            n_bytes;
-    int            line;
+    array_t        codes;
+    array_t        kerns;
+    u32           *code;
     font_cache_t  *font;
 
     font = pres->cur_font;
@@ -1351,94 +1579,60 @@ void draw_string(pres_t *pres, const char *str, int l_margin, int r_margin, int
 
     if (!str) { return; }
 
-    bytes = (unsigned char*)str;
+    codes = get_char_codes(str);
+    len   = array_len(codes);
+    kerns = get_kerning_offsets(font, array_data(codes), len);
 
-    len = strlen(str);
+    lines     = get_text_lines(pres, array_data(codes), array_data(kerns), len, l_margin, r_margin, justification);
+    line      = array_item(lines, 0);
+    last_line = array_last(lines);
 
-    wrap_points = get_wrap_points(pres, bytes, l_margin, r_margin, &line_widths);
-    line        = 0;
-
-    switch (justification) {
-        case JUST_L: break;
-        case JUST_R:
-            pres->draw_x += (pres->w - l_margin - r_margin) - *(int*)array_item(line_widths, line);
-            break;
-        case JUST_C:
-            pres->draw_x += ((pres->w - l_margin - r_margin) - *(int*)array_item(line_widths, line)) / 2;
-            break;
-    }
+    pres->draw_x += line->x;
 
-    for (i = 0; i < len;) {
+    for (i = 0; i < len; i += 1) {
         wrapped = 0;
 
-        code  = get_char_code(str + i, &n_bytes);
-        entry = get_glyph(font, code, pres->sdl_ren);
-
-        srect.x = entry->x;
-        srect.y = entry->y;
-        srect.w = entry->w;
-        srect.h = entry->h;
+        code  = array_item(codes, i);
+        entry = get_glyph(font, *code, pres->sdl_ren);
 
-        drect.x = pres->draw_x + entry->adjust_x;
-        drect.y = pres->draw_y - entry->adjust_y;
-        drect.w = entry->w;
-        drect.h = entry->h;
+        glyph_x = pres->draw_x;
+        glyph_y = pres->draw_y;
 
-        array_traverse(wrap_points, wrap_it) {
-            if (*wrap_it == i) {
-                line   += 1;
-                pres->draw_y += 1.25 * font->line_height;
-                pres->draw_x  = _x;
-
-                switch (justification) {
-                    case JUST_L: break;
-                    case JUST_R:
-                        pres->draw_x += (pres->w - l_margin - r_margin) - *(int*)array_item(line_widths, line);
-                        break;
-                    case JUST_C:
-                        pres->draw_x += ((pres->w - l_margin - r_margin) - *(int*)array_item(line_widths, line)) / 2;
-                        break;
-                }
-
-                wrapped = 1;
-                break;
-            }
+        if (i == line->end - 1 && line < last_line) {
+            line         += 1;
+            pres->draw_y += 1.25 * font->line_height;
+            pres->draw_x  = _x + line->x;
+            wrapped       = 1;
         }
 
-        if (IN_VIEW(pres)) {
-            SDL_RenderCopy(pres->sdl_ren, entry->texture, &srect, &drect);
-        }
+        dl_glyph(pres, entry, glyph_x, glyph_y, r, g, b);
 
         if (!wrapped) {
-            pres->draw_x += entry->pen_advance_x;
+            pres->draw_x += entry->pen_advance_x + *(i32*)array_item(kerns, i);
         }
         pres->draw_y += entry->pen_advance_y;
-
-        i += n_bytes;
     }
 
-    array_free(line_widths);
-    array_free(wrap_points);
+    array_free(lines);
+    array_free(kerns);
+    array_free(codes);
 }
 
-void draw_para_strings(pres_t *pres, pres_elem_t *elem) {
+static void compile_para_strings(pres_t *pres, pres_elem_t *elem) {
     int            _x, _y;
     font_entry_t  *entry;
-    SDL_Rect       srect,
-                   drect;
-    array_t        wrap_points;
-    array_t        line_widths;
-    int           *wrap_it;
+    int            glyph_x, glyph_y;
+    pres_line_t   *line;
+    pres_line_t   *last_line;
     int            wrapped;
-    char_code_t    code;
-    int            n_bytes;
-    int            line;
     font_cache_t  *font;
     int            i;
     pres_elem_t   *eit;
-    char          *c;
+    u32           *code;
+    i32           *kern;
     int            elem_start_x;
     SDL_Rect       urect;
+    int            have_urect;
     int            underline_line_height;
 
     font = pres_get_elem_font(pres, elem);
@@ -1457,20 +1651,10 @@ void draw_para_strings(pres_t *pres, pres_elem_t *elem) {
     pres->draw_y += font->line_height;
 
     /* compute_para_text() */
-    wrap_points = elem->wrap_points;
-    line_widths = elem->line_widths;
+    line      = array_item(elem->lines, 0);
+    last_line = array_last(elem->lines);
 
-    line = 0;
-
-    switch (elem->justification) {
-        case JUST_L: break;
-        case JUST_R:
-            pres->draw_x += (pres->w - elem->l_margin - elem->r_margin) - *(int*)array_item(line_widths, line);
-            break;
-        case JUST_C:
-            pres->draw_x += ((pres->w - elem->l_margin - elem->r_margin) - *(int*)array_item(line_widths, line)) / 2;
-            break;
-    }
+    pres->draw_x += line->x;
 
     i = 0;
 
@@ -1479,96 +1663,68 @@ void draw_para_strings(pres_t *pres, pres_elem_t *elem) {
         pres->cur_font = font;
 
         elem_start_x = pres->draw_x;
+        have_urect   = 0;
+        kern         = array_data(eit->kerns);
+        memset(&urect, 0, sizeof(urect));
 
-        if (IN_VIEW(pres)) {
-            set_font_color(font, eit->r, eit->g, eit->b);
-        }
-
-        array_traverse(eit->text, c) {
+        array_traverse(eit->codes, code) {
             wrapped = 0;
 
-            code  = get_char_code(c, &n_bytes);
-            entry = get_glyph(font, code, pres->sdl_ren);
-
-            srect.x = entry->x;
-            srect.y = entry->y;
-            srect.w = entry->w;
-            srect.h = entry->h;
-
-            drect.x = pres->draw_x + entry->adjust_x;
-            drect.y = pres->draw_y - entry->adjust_y;
-            drect.w = entry->w;
-            drect.h = entry->h;
-
-            array_traverse(wrap_points, wrap_it) {
-                if (*wrap_it == i) {
-                    line         += 1;
-                    pres->draw_y += 1.25 * font->line_height;
-                    pres->draw_x  = _x;
-
-                    switch (elem->justification) {
-                        case JUST_L: break;
-                        case JUST_R:
-                            pres->draw_x += (pres->w - elem->l_margin - elem->r_margin) - *(int*)array_item(line_widths, line);
-                            break;
-                        case JUST_C:
-                            pres->draw_x += ((pres->w - elem->l_margin - elem->r_margin) - *(int*)array_item(line_widths, line)) / 2;
-                            break;
-                    }
+            entry = get_glyph(font, *code, pres->sdl_ren);
 
-                    elem_start_x = pres->draw_x;
+            glyph_x = pres->draw_x;
+            glyph_y = pres->draw_y;
 
-                    wrapped = 1;
-                    break;
-                }
+            if (i == line->end - 1 && line < last_line) {
+                line         += 1;
+                pres->draw_y += 1.25 * font->line_height;
+                pres->draw_x  = _x + line->x;
+                elem_start_x  = pres->draw_x;
+                wrapped       = 1;
             }
 
-            if (IN_VIEW(pres)) {
-                SDL_RenderCopy(pres->sdl_ren, entry->texture, &srect, &drect);
-            }
+            dl_glyph(pres, entry, glyph_x, glyph_y, eit->r, eit->g, eit->b);
 
-            if (eit->flags & PRES_UNDERLINE
-            &&  IN_VIEW(pres)) {
-                SDL_SetRenderDrawColor(pres->sdl_ren,
-                                        elem->r,
-                                        elem->g,
-                                        elem->b,
-                                        255);
-                urect.x = elem_start_x;
-                urect.y = pres->draw_y;
-                urect.w = pres->draw_x - elem_start_x + entry->pen_advance_x;
-                urect.h = 0.025 * underline_line_height;
-                urect.y += urect.h;
-                SDL_RenderFillRect(pres->sdl_ren, &urect);
-                SDL_SetRenderDrawColor(pres->sdl_ren,
-                                        pres->r,
-                                        pres->g,
-                                        pres->b,
-                                        255);
+            /*
+             * The underline of a line grows with every glyph, so only
+             * the full one needs to be emitted, when the line wraps or
+             * the element ends.
+             */
+            if (eit->flags & PRES_UNDERLINE) {
+                if (wrapped && have_urect) {
+                    dl_rect(pres, urect.x, urect.y, urect.w, urect.h, elem->r, elem->g, elem->b);
+                }
+
+                urect.x    = elem_start_x;
+                urect.y    = pres->draw_y;
+                urect.w    = pres->draw_x - elem_start_x + entry->pen_advance_x;
+                urect.h    = 0.025 * underline_line_height;
+                urect.y   += urect.h;
+                have_urect = 1;
             }
 
             if (!wrapped) {
-                pres->draw_x += entry->pen_advance_x;
+                pres->draw_x += entry->pen_advance_x + *kern;
             }
             pres->draw_y += entry->pen_advance_y;
 
-            /* Update our iterator if this was a unicode multibyte sequence. */
-            c += n_bytes - 1;
-            i += n_bytes;
+            i    += 1;
+            kern += 1;
         }
-    }
 
-/*     array_free(line_widths); */
-/*     array_free(wrap_points); */
+        if (have_urect) {
+            dl_rect(pres, urect.x, urect.y, urect.w, urect.h, elem->r, elem->g, elem->b);
+        }
+    }
 }
 
-static void draw_para(pres_t *pres, pres_elem_t *elem) {
-    draw_para_strings(pres, elem);
+static void compile_para(pres_t *pres, pres_elem_t *elem) {
+    compile_para_strings(pres, elem);
 
     pres->is_translating = 0;
 }
 
-static void draw_bullet(pres_t *pres, pres_elem_t *elem) {
+static void compile_bullet(pres_t *pres, pres_elem_t *elem) {
     int save_draw_x,
         save_draw_y;
     int new_l_margin;
@@ -1576,17 +1732,16 @@ static void draw_bullet(pres_t *pres, pres_elem_t *elem) {
 
     pres->cur_font = pres_get_elem_font(pres, elem);
 
-    set_font_color(pres->cur_font, elem->r, elem->g, elem->b);
-
     save_draw_x = pres->draw_x;
     save_draw_y = pres->draw_y;
 
     new_l_margin =   elem->l_margin
                    + ((0.05 * (elem->level - 1)) * pres->w);
 
-    draw_string(pres,
-                pres->bullet_strings[elem->level - 1],
-                new_l_margin, elem->r_margin, JUST_L);
+    compile_string(pres,
+                   pres->bullet_strings[elem->level - 1],
+                   new_l_margin, elem->r_margin, JUST_L,
+                   elem->r, elem->g, elem->b);
 
     new_l_margin = pres->draw_x - save_draw_x;
     pres->draw_x = save_draw_x;
@@ -1594,13 +1749,13 @@ static void draw_bullet(pres_t *pres, pres_elem_t *elem) {
 
     save_l_margin  = elem->l_margin;
     elem->l_margin = new_l_margin;
-    draw_para_strings(pres, elem);
+    compile_para_strings(pres, elem);
     elem->l_margin = save_l_margin;
 
     pres->is_translating = 0;
 }
 
-static void draw_break(pres_t *pres, pres_elem_t *elem) {
+static void compile_break(pres_t *pres, pres_elem_t *elem) {
     if (pres->cur_font) {
         pres->draw_y += 0.75 * pres->cur_font->line_height;
     }
@@ -1608,40 +1763,34 @@ static void draw_break(pres_t *pres, pres_elem_t *elem) {
     pres->is_translating = 0;
 }
 
-static void draw_vspace(pres_t *pres, pres_elem_t *elem) {
+static void compile_vspace(pres_t *pres, pres_elem_t *elem) {
     pres->draw_y         += elem->y;
     pres->is_translating  = 0;
 }
 
-static void draw_vfill(pres_t *pres, pres_elem_t *elem) {
-    pres->draw_y         += pres->h - ((pres->draw_y - pres->view_y) % pres->h);
+static void compile_vfill(pres_t *pres, pres_elem_t *elem) {
+    pres->draw_y         += pres->h - (pres->draw_y % pres->h);
     pres->is_translating  = 0;
 }
 
-static void handle_point(pres_t *pres, pres_elem_t *elem) {
-    pres->save_points[pres->n_points]  = -(pres->draw_y - pres->view_y);
-    pres->n_points                    += 1;
-}
+static void compile_point(pres_t *pres, pres_elem_t *elem) {
+    pres_dl_range_t range;
 
-static void draw_image(pres_t *pres, pres_elem_t *elem) {
-    sdl_texture_t image_texture;
-    SDL_Rect      drect;
+    pres->save_points[pres->n_points]  = -pres->draw_y;
+    pres->n_points                    += 1;
 
-    if (IN_VIEW(pres)) {
-        drect.x = pres->draw_x;
-        drect.y = pres->draw_y;
-        drect.w = elem->w;
-        drect.h = elem->h;
+    dl_range_init(&range, array_len(pres->dl_items));
+    array_push(pres->dl_ranges, range);
+}
 
-        image_texture = pres_get_image_texture(pres, elem->image);
-        SDL_RenderCopy(pres->sdl_ren, image_texture, NULL, &drect);
-    }
+static void compile_image(pres_t *pres, pres_elem_t *elem) {
+    dl_image(pres, elem->image, pres->draw_x, pres->draw_y, elem->w, elem->h);
 
     pres->draw_y         += elem->h;
     pres->is_translating  = 0;
 }
 
-static void draw_save(pres_t *pres, pres_elem_t *elem) {
+static void compile_save(pres_t *pres, pres_elem_t *elem) {
     mark_name_t key;
     mark_map_it it;
 
@@ -1650,10 +1799,10 @@ static void draw_save(pres_t *pres, pres_elem_t *elem) {
     it = tree_lookup(pres->marks, elem->mark_name);
     if (!tree_it_good(it)) { key = strdup(key); }
 
-    tree_insert(pres->marks, key, pres->draw_y - pres->view_y);
+    tree_insert(pres->marks, key, pres->draw_y);
 }
 
-static void draw_restore(pres_t *pres, pres_elem_t *elem) {
+static void compile_restore(pres_t *pres, pres_elem_t *elem) {
     mark_map_it it;
     int         dst;
 
@@ -1663,30 +1812,222 @@ static void draw_restore(pres_t *pres, pres_elem_t *elem) {
         dst = tree_it_val(it);
     }
 
-    pres->draw_y         = pres->view_y + dst;
+    pres->draw_y = dst;
 }
 
-static void draw_goto(pres_t *pres, pres_elem_t *elem) {
+static void compile_goto(pres_t *pres, pres_elem_t *elem) {
     pres->is_translating = 1;
     pres->draw_x         = elem->x;
-    pres->draw_y         = pres->draw_y - ((pres->draw_y - pres->view_y) % pres->h) + elem->y;
+    pres->draw_y         = pres->draw_y - (pres->draw_y % pres->h) + elem->y;
 }
 
-static void draw_gotox(pres_t *pres, pres_elem_t *elem) {
+static void compile_gotox(pres_t *pres, pres_elem_t *elem) {
     pres->is_translating = 1;
-    pres->draw_x         = pres->view_x + elem->x;
+    pres->draw_x         = elem->x;
 }
 
-static void draw_gotoy(pres_t *pres, pres_elem_t *elem) {
-    pres->draw_y = pres->draw_y - ((pres->draw_y - pres->view_y) % pres->h) + elem->y;
+static void compile_gotoy(pres_t *pres, pres_elem_t *elem) {
+    pres->draw_y = pres->draw_y - (pres->draw_y % pres->h) + elem->y;
 }
 
-static void draw_translate(pres_t *pres, pres_elem_t *elem) {
+static void compile_translate(pres_t *pres, pres_elem_t *elem) {
     pres->is_translating  = 1;
     pres->draw_x         += elem->x;
     pres->draw_y         += elem->y;
 }
 
+#define HASH_INIT (14695981039346656037ULL)
+
+static u64 hash_bytes(u64 hash, const void *bytes, int n) {
+    const unsigned char *p;
+    int                  i;
+
+    p = bytes;
+
+    for (i = 0; i < n; i += 1) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+#define HASH_VAL(hash, val) ((hash) = hash_bytes((hash), &(val), sizeof(val)))
+
+/*
+ * Slides are hashed relative to their own top, so a slide that only
+ * moved within the deck (e.g. after a slide was inserted before it)
+ * keeps its hash. Image files aren't hashed; slides with images hash
+ * the build number instead and are always redrawn after a reload.
+ */
+static void build_slide_hashes(pres_t *pres) {
+    static u64       n_builds;
+    array_t         *bucket;
+    int             *idx;
+    pres_dl_range_t *range;
+    pres_dl_item_t  *item;
+    u64              hash;
+    int              s, i;
+    int              y;
+
+    n_builds += 1;
+
+    for (s = 0; s < array_len(pres->view_index); s += 1) {
+        hash = HASH_INIT;
+        HASH_VAL(hash, pres->w); HASH_VAL(hash, pres->h);
+        HASH_VAL(hash, pres->r); HASH_VAL(hash, pres->g); HASH_VAL(hash, pres->b);
+
+        bucket = array_item(pres->view_index, s);
+
+        array_traverse(*bucket, idx) {
+            range = array_item(pres->dl_elem_ranges, *idx);
+
+            for (i = range->start; i < range->end; i += 1) {
+                item = array_item(pres->dl_items, i);
+                y    = item->y - s * (int)pres->h;
+
+                HASH_VAL(hash, item->kind);
+                HASH_VAL(hash, item->x); HASH_VAL(hash, y);
+                HASH_VAL(hash, item->w); HASH_VAL(hash, item->h);
+                HASH_VAL(hash, item->r); HASH_VAL(hash, item->g); HASH_VAL(hash, item->b);
+                HASH_VAL(hash, item->entry);
+
+                if (item->kind == PRES_DL_IMAGE) {
+                    HASH_VAL(hash, n_builds);
+                }
+            }
+        }
+
+        array_push(pres->slide_hashes, hash);
+    }
+}
+
+/*
+ * The view index maps every slide-sized band of the deck to the element
+ * ranges that overlap it. A view spans at most max_view_slides + 1 bands,
+ * so finding what to draw doesn't depend on the length of the deck.
+ */
+
+static int slide_of_y(pres_t *pres, int y) {
+    int slide;
+
+    slide = (y < 0) ? 0 : y / (int)pres->h;
+
+    return MIN(slide, array_len(pres->view_index) - 1);
+}
+
+static void build_view_index(pres_t *pres) {
+    pres_dl_range_t *range;
+    int              max_y;
+    int              n_slides;
+    array_t          bucket;
+    int              i, s;
+
+    max_y = 0;
+    array_traverse(pres->dl_elem_ranges, range) {
+        max_y = MAX(max_y, range->y1);
+    }
+
+    n_slides = (max_y / (int)pres->h) + 1;
+
+    for (s = 0; s < n_slides; s += 1) {
+        bucket = array_make(int);
+        array_push(pres->view_index, bucket);
+    }
+
+    for (i = 0; i < array_len(pres->dl_elem_ranges); i += 1) {
+        range = array_item(pres->dl_elem_ranges, i);
+
+        for (s = slide_of_y(pres, range->y0); s <= slide_of_y(pres, range->y1 - 1); s += 1) {
+            array_push(*(array_t*)array_item(pres->view_index, s), i);
+        }
+    }
+
+    build_slide_hashes(pres);
+}
+
+static int cmp_int(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+/*
+ * Fills pres->view_visible with the element ranges overlapping [top, bottom),
+ * in drawing order. Only lookups for drawing a frame count towards the
+ * culling stats (n_visited, n_drawn).
+ */
+static void query_view_index(pres_t *pres, int top, int bottom, int for_draw) {
+    pres_dl_range_t *range;
+    array_t         *bucket;
+    int             *idx;
+    int              s;
+
+    array_clear(pres->view_visible);
+
+    if (array_len(pres->view_index) == 0) { return; }
+
+    /* Ranges that span several slides are only visited once per query. */
+    pres->view_stamp += 1;
+
+    for (s = slide_of_y(pres, top); s <= slide_of_y(pres, bottom - 1); s += 1) {
+        bucket = array_item(pres->view_index, s);
+
+        array_traverse(*bucket, idx) {
+            range = array_item(pres->dl_elem_ranges, *idx);
+
+            if (range->stamp == pres->view_stamp) { continue; }
+
+            range->stamp = pres->view_stamp;
+            if (for_draw) { pres->n_visited += 1; }
+
+            if (range->y1 > top && range->y0 < bottom) {
+                array_push(pres->view_visible, *idx);
+            }
+        }
+    }
+
+    qsort(array_data(pres->view_visible), array_len(pres->view_visible), sizeof(int), cmp_int);
+
+    if (for_draw) { pres->n_drawn += array_len(pres->view_visible); }
+}
+
+static void compile_display_list(pres_t *pres) {
+    pres_elem_t *elem;
+
+    pres->draw_x         = 0;
+    pres->draw_y         = 0;
+    pres->n_points       = 0;
+    pres->is_translating = 0;
+    pres->cur_font       = NULL;
+
+    array_traverse(pres->elements, elem) {
+        dl_range_init(&cur_elem_range, array_len(pres->dl_items));
+
+        switch (elem->kind) {
+            case PRES_PARA:      compile_para(pres, elem);      break;
+            case PRES_BULLET:    compile_bullet(pres, elem);    break;
+            case PRES_BREAK:     compile_break(pres, elem);     break;
+            case PRES_VSPACE:    compile_vspace(pres, elem);    break;
+            case PRES_VFILL:     compile_vfill(pres, elem);     break;
+            case PRES_IMAGE:     compile_image(pres, elem);     break;
+            case PRES_SAVE:      compile_save(pres, elem);      break;
+            case PRES_RESTORE:   compile_restore(pres, elem);   break;
+            case PRES_GOTO:      compile_goto(pres, elem);      break;
+            case PRES_GOTOX:     compile_gotox(pres, elem);     break;
+            case PRES_GOTOY:     compile_gotoy(pres, elem);     break;
+            case PRES_TRANSLATE: compile_translate(pres, elem); break;
+            case PRES_POINT:     compile_point(pres, elem);     break;
+        }
+
+        if (cur_elem_range.end > cur_elem_range.start) {
+            array_push(pres->dl_elem_ranges, cur_elem_range);
+        }
+
+        if (!pres->is_translating) { pres->draw_x = 0; }
+    }
+
+    build_view_index(pres);
+}
+
 static void do_animation(pres_t *pres) {
     u64    cur_t_ns,
            dt_ns;
@@ -1733,37 +2074,51 @@ static void do_animation(pres_t *pres) {
     }
 }
 
+static void replay_range(pres_t *pres, pres_dl_range_t *range) {
+    pres_dl_item_t *item;
+    SDL_Rect        r;
+    int             i;
+
+    for (i = range->start; i < range->end; i += 1) {
+        item = array_item(pres->dl_items, i);
+
+        r.x = pres->view_x + item->x;
+        r.y = pres->view_y + item->y;
+        r.w = item->w;
+        r.h = item->h;
+
+        switch (item->kind) {
+            case PRES_DL_GLYPH:
+                batch_glyph(pres->sdl_ren, item->entry, r.x, r.y, item->r, item->g, item->b);
+                break;
+            case PRES_DL_RECT:
+                SDL_SetRenderDrawColor(pres->sdl_ren, item->r, item->g, item->b, 255);
+                batch_fill_rect(pres->sdl_ren, &r);
+                break;
+            case PRES_DL_IMAGE:
+                batch_copy(pres->sdl_ren, pres_get_image_texture(pres, item->image), NULL, &r);
+                break;
+        }
+    }
+}
+
 static void _draw_presentation(pres_t *pres, int clear) {
-    pres_elem_t *elem;
+    int  top;
+    int *idx;
 
     if (clear) {
         pres_clear_and_draw_bg(pres);
     }
 
-    pres->draw_x         = pres->view_x;
-    pres->draw_y         = pres->view_y;
-    pres->n_points       = 0;
-    pres->is_translating = 0;
+    top = -pres->view_y;
 
-    array_traverse(pres->elements, elem) {
-        switch (elem->kind) {
-            case PRES_PARA:      draw_para(pres, elem);      break;
-            case PRES_BULLET:    draw_bullet(pres, elem);    break;
-            case PRES_BREAK:     draw_break(pres, elem);     break;
-            case PRES_VSPACE:    draw_vspace(pres, elem);    break;
-            case PRES_VFILL:     draw_vfill(pres, elem);     break;
-            case PRES_IMAGE:     draw_image(pres, elem);     break;
-            case PRES_SAVE:      draw_save(pres, elem);      break;
-            case PRES_RESTORE:   draw_restore(pres, elem);   break;
-            case PRES_GOTO:      draw_goto(pres, elem);      break;
-            case PRES_GOTOX:     draw_gotox(pres, elem);     break;
-            case PRES_GOTOY:     draw_gotoy(pres, elem);     break;
-            case PRES_TRANSLATE: draw_translate(pres, elem); break;
-            case PRES_POINT:     handle_point(pres, elem);   break;
-        }
+    query_view_index(pres, top, top + pres->max_view_slides * pres->h, 1);
 
-        if (!pres->is_translating) { pres->draw_x = 0; }
+    array_traverse(pres->view_visible, idx) {
+        replay_range(pres, array_item(pres->dl_elem_ranges, *idx));
     }
+
+    batch_flush(pres->sdl_ren);
 }
 
 void draw_presentation(pres_t *pres) {
@@ -1774,6 +2129,88 @@ void draw_presentation_no_clear(pres_t *pres) {
     _draw_presentation(pres, 0);
 }
 
+/* Draws one slide of the deck as if the view was scrolled to its top. */
+void draw_presentation_slide(pres_t *pres, int slide, int clear) {
+    int save_view_x;
+    int save_view_y;
+    int save_max_view_slides;
+
+    save_view_x          = pres->view_x;
+    save_view_y          = pres->view_y;
+    save_max_view_slides = pres->max_view_slides;
+
+    pres->view_x          = 0;
+    pres->view_y          = -slide * (int)pres->h;
+    pres->max_view_slides = 1;
+
+    _draw_presentation(pres, clear);
+
+    pres->view_x          = save_view_x;
+    pres->view_y          = save_view_y;
+    pres->max_view_slides = save_max_view_slides;
+}
+
+/*
+ * Leaves the display list ranges that are on slide in pres->view_visible,
+ * in drawing order, for consumers of the display list other than the
+ * renderer.
+ */
+void pres_query_slide(pres_t *pres, int slide) {
+    query_view_index(pres, slide * (int)pres->h, (slide + 1) * (int)pres->h, 0);
+}
+
+int pres_n_slides(pres_t *pres) {
+    return array_len(pres->view_index);
+}
+
+u64 pres_slide_hash(pres_t *pres, int slide) {
+    return *(u64*)array_item(pres->slide_hashes, slide);
+}
+
+/*
+ * Creates at most one of the image textures that are visible at point
+ * so that the first draw there doesn't have to.
+ * Returns 1 if a texture was created.
+ */
+int pres_prefetch_image(pres_t *pres, int point) {
+    int                top;
+    int               *idx;
+    pres_dl_range_t   *range;
+    pres_dl_item_t    *item;
+    int                i;
+    image_map_it       it;
+    pres_image_data_t *image_data;
+
+    if (pres->sdl_ren == NULL || point < 0 || point >= pres->n_points) { return 0; }
+
+    top = -pres->save_points[point];
+
+    query_view_index(pres, top, top + pres->max_view_slides * pres->h, 0);
+
+    array_traverse(pres->view_visible, idx) {
+        range = array_item(pres->dl_elem_ranges, *idx);
+
+        for (i = range->start; i < range->end; i += 1) {
+            item = array_item(pres->dl_items, i);
+
+            if (item->kind != PRES_DL_IMAGE) { continue; }
+
+            it = tree_lookup(pres->images, item->image);
+            if (!tree_it_good(it)) { continue; }
+
+            image_data = &tree_it_val(it);
+
+            if (image_data->texture == NULL) {
+                pres_create_image_texture(pres, image_data);
+                image_data->prefetched = 1;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
 void update_presentation(pres_t *pres) {
     pres->movement_started = 0;
     do_animation(pres);
@@ -5,6 +5,7 @@
 #include "array.h"
 #include "tree.h"
 #include "font.h"
+#include "batch.h"
 #include "threadpool.h"
 
 enum {
@@ -36,17 +37,30 @@ enum {
 #define PRES_ITALIC    (1ULL << 1)
 #define PRES_UNDERLINE (1ULL << 2)
 
+/*
+ * A line of wrapped text: the codes [start, end) and where it starts.
+ * A space that the text is broken at ends its line.
+ */
+typedef struct {
+    int start, end;
+    int x;          /* from the left margin, after justification */
+    int width;
+} pres_line_t;
+
 typedef struct {
     int      kind;
     int      x, y, w, h;
     int      level;
     array_t  text;
+    array_t  codes;      /* text decoded into u32 char codes by compute_text() */
+    array_t  kerns;      /* i32 kerning after each code, see get_kerning_offsets() */
     array_t  para_elems;
     i32      font_id,
              font_bold_id,
              font_italic_id,
              font_bold_italic_id;
     u32      font_size;
+    font_cache_t *fonts[4]; /* the fonts above, resolved by pres_get_elem_font() */
     u32      r, g, b;
     u32      l_margin, r_margin;
     int      justification;
@@ -56,9 +70,9 @@ typedef struct {
     };
     u32      flags;
 
-    array_t  all_text;
-    array_t  wrap_points;
-    array_t  line_widths;
+    array_t  all_codes;
+    array_t  all_kerns;
+    array_t  lines;      /* pres_line_t over all_codes, from compute_text() */
 } pres_elem_t;
 
 typedef char *macro_name_t;
@@ -72,6 +86,7 @@ typedef struct {
     void          *image_data;
     sdl_texture_t  texture;
     int            w, h;
+    int            prefetched; /* texture was created ahead of its first draw */
 } pres_image_data_t;
 
 typedef char *image_path_t;
@@ -79,6 +94,30 @@ use_tree(image_path_t, pres_image_data_t);
 typedef tree(image_path_t, pres_image_data_t)    image_map_t;
 typedef tree_it(image_path_t, pres_image_data_t) image_map_it;
 
+enum {
+    PRES_DL_GLYPH,
+    PRES_DL_RECT,
+    PRES_DL_IMAGE,
+};
+
+/* A positioned primitive in slide coordinates. */
+typedef struct {
+    int               kind;
+    int               x, y, w, h; /* glyphs: (x, y) is the pen position */
+    u32               r, g, b;
+    union {
+    font_entry_t     *entry;
+    char             *image;
+    };
+} pres_dl_item_t;
+
+/* A run of items (one point's or one element's) and the vertical extent they cover. */
+typedef struct {
+    int start, end;
+    int y0, y1;
+    u32 stamp;
+} pres_dl_range_t;
+
 typedef char *mark_name_t;
 use_tree(mark_name_t, int);
 typedef tree(mark_name_t, int)    mark_map_t;
@@ -89,7 +128,18 @@ typedef struct {
 
     SDL_Renderer *sdl_ren;
     array_t       elements;
+    array_t       dl_items;
+    array_t       dl_ranges;
+    array_t       dl_elem_ranges;
+    array_t       view_index;    /* per slide: indices into dl_elem_ranges that overlap it */
+    array_t       slide_hashes;  /* per slide: hash of everything drawn on it */
+    array_t       view_visible;
+    u32           view_stamp;
+    u32           n_visited, n_drawn;
+    u32           n_prefetch_used; /* prefetched textures drawn for the first time */
     array_t       fonts;
+    array_t       fallback_fonts; /* char* paths, from :font-fallback */
+    int           glyphs_reloaded; /* a fallback change loaded glyphs into old entries */
     macro_map_t   macros;
     char         *collect_macro;
     int           beg_end_match;
@@ -123,11 +173,17 @@ char * pres_get_font_name_by_id(pres_t *pres, u32 id);
 font_cache_t * pres_get_elem_font(pres_t *pres, pres_elem_t *elem);
 pres_image_data_t * pres_get_image_data(pres_t *pres, const char *image);
 sdl_texture_t pres_get_image_texture(pres_t *pres, const char *image);
-array_t get_wrap_points(pres_t *pres, const unsigned char *bytes, int l_margin, int r_margin, array_t *line_widths);
+int pres_prefetch_image(pres_t *pres, int point);
+array_t get_text_lines(pres_t *pres, const u32 *codes, const i32 *kerns, int len, int l_margin, int r_margin, int justification);
+void justify_text_lines(pres_t *pres, array_t lines, int l_margin, int r_margin, int justification);
 
 void pres_clear_and_draw_bg(pres_t *pres);
 void draw_presentation(pres_t *pres);
 void draw_presentation_no_clear(pres_t *pres);
+void draw_presentation_slide(pres_t *pres, int slide, int clear);
+int pres_n_slides(pres_t *pres);
+void pres_query_slide(pres_t *pres, int slide);
+u64 pres_slide_hash(pres_t *pres, int slide);
 void update_presentation(pres_t *pres);
 void pres_restore_point(pres_t *pres, int point);
 void pres_next_point(pres_t *pres);
@@ -1,6 +1,8 @@
 #include "internal.h"
 #include "font.h"
 #include "presentation.h"
+#include "slide_cache.h"
+#include "thumbnails.h"
 #include "pdf.h"
 
 typedef struct {
@@ -11,6 +13,16 @@ typedef struct {
     int         to_pdf;
     const char *to_pdf_name;
     float       pdf_quality;
+    int         stats;
+    int         slide_cache;
+    u64         slide_cache_mb;
+    int         prefetch;
+    int         wait_events;
+    int         shared_atlas;
+    int         glyph_cache;
+    const char *glyph_cache_dir;
+    u64         glyph_budget_mb;
+    int         bench_glyphs;
 } options_t;
 
 options_t options;
@@ -47,6 +59,38 @@ static char *usage =
 "--pdf-quality=FLOAT\n"
 "    Export the PDF at FLOAT quality where FLOAT is in the\n"
 "    range [0.0, 1.0]. Default value is 1.0 (full quality).\n"
+"--slide-cache[=MB]\n"
+"    Render each slide once into a texture and draw from those\n"
+"    while presenting. At most MB megabytes of textures are kept\n"
+"    (default 256).\n"
+"--prefetch[=N]\n"
+"    While idle, prepare the next and previous N points (default 2)\n"
+"    so that moving to them doesn't stall: image textures are\n"
+"    created and, with --slide-cache, the slides are rendered.\n"
+"--wait-events\n"
+"    Block until something happens instead of polling for input\n"
+"    and redrawing periodically, to save CPU while presenting.\n"
+"--shared-atlas\n"
+"    Rasterise glyphs once per font file at sizes a half octave\n"
+"    apart (512px down to about 11px) and scale the nearest larger\n"
+"    one down for every :size, instead of rasterising each size\n"
+"    separately. Uses less memory and loads faster with many\n"
+"    sizes, at some cost in glyph sharpness.\n"
+"--glyph-budget=MB\n"
+"    Keep at most MB megabytes of glyph atlas textures (default\n"
+"    256). The least recently drawn pages are dropped and their\n"
+"    glyphs rasterised again when they're needed.\n"
+"--glyph-cache[=DIR]\n"
+"    Keep rasterised glyphs on disk in DIR (default\n"
+"    $XDG_CACHE_HOME/slide or ~/.cache/slide) so that later runs\n"
+"    don't have to render them again.\n"
+"--stats\n"
+"    Print font atlas statistics after loading the presentation\n"
+"    and rendering and idle CPU statistics once per second while\n"
+"    presenting.\n"
+"--bench-glyphs\n"
+"    Time glyph lookups for all of the presentation's text,\n"
+"    print the results for each font, and exit.\n"
 "--help\n"
 "    Show this information.\n"
 "\n"
@@ -61,7 +105,9 @@ static void parse_options(int argc, char **argv) {
     char  path_cpy[1024];
     char *ext_point;
 
-    options.pdf_quality = 1.0;
+    options.pdf_quality     = 1.0;
+    options.slide_cache_mb  = 256;
+    options.glyph_budget_mb = FONT_ATLAS_DEFAULT_BUDGET_MB;
 
     for (i = 1; i < argc; i += 1) {
         if (strncmp(argv[i], "--startup-pause", 15) == 0) {
@@ -91,6 +137,39 @@ static void parse_options(int argc, char **argv) {
             if (options.pdf_quality < 0.0 || options.pdf_quality > 1.0) {
                 err_usage();
             }
+        } else if (strncmp(argv[i], "--slide-cache=", 14) == 0) {
+            if (sscanf(argv[i] + 14, "%lu", &options.slide_cache_mb) != 1) {
+                err_usage();
+            }
+            options.slide_cache = 1;
+        } else if (strcmp(argv[i], "--slide-cache") == 0) {
+            options.slide_cache = 1;
+        } else if (strncmp(argv[i], "--prefetch=", 11) == 0) {
+            if (sscanf(argv[i] + 11, "%d", &options.prefetch) != 1 || options.prefetch < 0) {
+                err_usage();
+            }
+        } else if (strcmp(argv[i], "--prefetch") == 0) {
+            options.prefetch = 2;
+        } else if (strcmp(argv[i], "--wait-events") == 0) {
+            options.wait_events = 1;
+        } else if (strcmp(argv[i], "--shared-atlas") == 0) {
+            options.shared_atlas = 1;
+        } else if (strncmp(argv[i], "--glyph-budget=", 15) == 0) {
+            if (sscanf(argv[i] + 15, "%lu", &options.glyph_budget_mb) != 1 || options.glyph_budget_mb == 0) {
+                err_usage();
+            }
+        } else if (strncmp(argv[i], "--glyph-cache=", 14) == 0) {
+            options.glyph_cache_dir = argv[i] + 14;
+            if (strlen(options.glyph_cache_dir) == 0) {
+                err_usage();
+            }
+            options.glyph_cache = 1;
+        } else if (strcmp(argv[i], "--glyph-cache") == 0) {
+            options.glyph_cache = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            options.stats = 1;
+        } else if (strcmp(argv[i], "--bench-glyphs") == 0) {
+            options.bench_glyphs = 1;
         } else if (strcmp(argv[i], "--help") == 0) {
             print_usage();
             exit(0);
@@ -125,27 +204,209 @@ int           show_grid;
 int           show_minimap;
 int           minimap_point;
 int           minimap_save_point;
+int           minimap_thumbnails;
 u32           start_ms;
 
 void do_pdf_export(void);
 void do_present(void);
-void handle_input(int *quit, int *reloading, int *show_grid, int *show_minimap, int *winch);
+int  handle_input(int *quit, int *reloading, int *show_grid, int *show_minimap, int *winch);
 
 int  init_video(void);
 void fini_video(void);
 
-void draw_simple_string_at(int x, int y, const char *str, font_cache_t *font);
+void draw_simple_string_at(int x, int y, const char *str, font_cache_t *font, u32 r, u32 g, u32 b);
 void draw_time(float time);
 
+typedef struct {
+    u32 start_ms;
+    u32 n_frames;
+    u32 draw_calls;
+    u32 max_draw_calls;
+    u32 visited;
+    u32 drawn;
+    u64 idle_wall_us;
+    u64 idle_cpu_us;
+} stats_t;
+
+stats_t stats;
+u64     session_idle_wall_us;
+u64     session_idle_cpu_us;
+
+static u64 cpu_time_us(void) {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return   (u64)usage.ru_utime.tv_sec * 1000000 + usage.ru_utime.tv_usec
+           + (u64)usage.ru_stime.tv_sec * 1000000 + usage.ru_stime.tv_usec;
+}
+
+/* Frames that didn't draw anything count as idle. */
+static void stats_idle(u64 wall_us, u64 cpu_us) {
+    stats.idle_wall_us   += wall_us;
+    stats.idle_cpu_us    += cpu_us;
+    session_idle_wall_us += wall_us;
+    session_idle_cpu_us  += cpu_us;
+}
+
+typedef struct {
+    int point;      /* point that the neighbours were prepared around */
+    int done;
+    u32 n_images;
+    u32 n_slides;
+    u32 frames_saved;
+} prefetch_t;
+
+prefetch_t prefetch;
+
+static void stats_frame(void) {
+    u32 draw_calls;
+
+    draw_calls = batch_get_draw_calls();
+
+    stats.n_frames   += 1;
+    stats.draw_calls += draw_calls;
+    stats.visited    += pres.n_visited;
+    stats.drawn      += pres.n_drawn;
+
+    if (draw_calls > stats.max_draw_calls) {
+        stats.max_draw_calls = draw_calls;
+    }
+}
+
+static void stats_report(void) {
+    u32                       now_ms;
+    slide_cache_stats_t       cache_stats;
+    font_atlas_budget_stats_t atlas_stats;
+
+    now_ms = SDL_GetTicks();
+
+    if (now_ms - stats.start_ms < 1000) { return; }
+
+    if (stats.n_frames) {
+        printf("[stats] %u frames, draw calls per frame: avg %u, max %u\n",
+               stats.n_frames,
+               stats.draw_calls / stats.n_frames,
+               stats.max_draw_calls);
+        printf("[stats] elements per frame: %u visited, %u drawn, %d in deck\n",
+               stats.visited / stats.n_frames,
+               stats.drawn / stats.n_frames,
+               array_len(pres.dl_elem_ranges));
+    }
+
+    if (stats.idle_wall_us) {
+        printf("[stats] idle: %.1f%% CPU over %lums\n",
+               100.0 * stats.idle_cpu_us / stats.idle_wall_us,
+               stats.idle_wall_us / 1000);
+    }
+
+    if (options.slide_cache) {
+        get_slide_cache_stats(&cache_stats);
+        printf("[stats] slide cache: %d slides, %luMB of %luMB, %u hits, %u misses, %u evictions\n",
+               cache_stats.n_slides,
+               cache_stats.bytes  / (1024 * 1024),
+               cache_stats.budget / (1024 * 1024),
+               cache_stats.hits,
+               cache_stats.misses,
+               cache_stats.evictions);
+    }
+
+    get_font_atlas_budget_stats(&atlas_stats);
+    printf("[stats] glyph atlas: %u pages, %luMB of %luMB, %u pages evicted (%u glyphs), %u glyphs restored\n",
+           atlas_stats.n_pages,
+           atlas_stats.bytes  / (1024 * 1024),
+           atlas_stats.budget / (1024 * 1024),
+           atlas_stats.evictions,
+           atlas_stats.evicted_glyphs,
+           atlas_stats.restored_glyphs);
+
+    if (options.prefetch) {
+        printf("[stats] prefetch: %u images, %u slides, %u frames saved\n",
+               prefetch.n_images,
+               prefetch.n_slides,
+               prefetch.frames_saved);
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    stats.start_ms = now_ms;
+}
+
+/*
+ * Prepares the neighbours of the current point, nearest first, one
+ * texture at a time until deadline_ms.
+ */
+static void prefetch_neighbours(u32 deadline_ms) {
+    int i;
+    int point;
+    int did_work;
+
+    if (prefetch.point != (int)pres.point) {
+        prefetch.point = pres.point;
+        prefetch.done  = 0;
+    }
+
+    while (!prefetch.done && SDL_GetTicks() < deadline_ms) {
+        did_work = 0;
+
+        for (i = 0; i < 2 * options.prefetch && !did_work; i += 1) {
+            point = i & 1 ? pres.point - (i / 2 + 1) : pres.point + (i / 2 + 1);
+
+            if (pres_prefetch_image(&pres, point)) {
+                prefetch.n_images += 1;
+                did_work           = 1;
+            } else if (slide_cache_prefetch(&pres, point)) {
+                prefetch.n_slides += 1;
+                did_work           = 1;
+            }
+        }
+
+        prefetch.done = !did_work;
+    }
+}
+
 static void update_window_resolution(pres_t *pres) {
     SDL_RenderSetLogicalSize(sdl_ren, pres->w, pres->h);
 }
 
+/*
+ * Rasterises glyphs for the output pixels that a w x h logical area is
+ * drawn to. Anything that was drawn at the old scale is thrown away.
+ * Returns 1 if the scale changed.
+ */
+static int update_raster_scale(int w, int h) {
+    int out_w, out_h;
+
+    if (sdl_ren == NULL) { return 0; }
+
+    SDL_GetRendererOutputSize(sdl_ren, &out_w, &out_h);
+
+    if (!font_set_raster_scale(MIN((float)out_w / w, (float)out_h / h), sdl_ren)) {
+        return 0;
+    }
+
+    slide_cache_invalidate();
+    free_thumbnails();
+
+    return 1;
+}
+
 void reload_pres(pres_t *pres, const char *path) {
     free_presentation(pres);
     *pres = build_presentation(path, sdl_ren);
     update_window_resolution(pres);
+
+    /*
+     * Slides are cached by glyph entry, and entries whose fallback font
+     * changed now hold different glyphs.
+     */
+    if (!update_raster_scale(pres->w, pres->h) && pres->glyphs_reloaded) {
+        slide_cache_invalidate();
+        free_thumbnails();
+    }
+
     printf("reloaded '%s'\n", path);
+
+    if (options.stats) { print_font_atlas_stats(); }
 }
 
 static void handle_hup(int sig) {
@@ -167,6 +428,40 @@ static void register_hup_handler(void) {
     sigaction(SIGHUP, &sa, NULL);
 }
 
+/* Glyph lookups for all of the deck's paragraph text, for every font. */
+static void bench_glyphs(void) {
+    array_t      codes;
+    pres_elem_t *elem;
+
+    codes = array_make(u32);
+
+    array_traverse(pres.elements, elem) {
+        if (elem->kind == PRES_PARA
+        ||  elem->kind == PRES_BULLET) {
+            array_push_n(codes, array_data(elem->all_codes), array_len(elem->all_codes));
+        }
+    }
+
+    font_bench_glyph_lookup(array_data(codes), array_len(codes), sdl_ren);
+
+    array_free(codes);
+}
+
+/* Counts are for the run so far, so that startup and the session can be told apart. */
+static void print_glyph_cache_stats(const char *when) {
+    glyph_cache_stats_t glyph_stats;
+
+    if (!options.glyph_cache) { return; }
+
+    get_glyph_cache_stats(&glyph_stats);
+    printf("[glyph cache] %s: %u files, %u glyphs from disk, %u rendered, %u files written\n",
+           when,
+           glyph_stats.n_files,
+           glyph_stats.hits,
+           glyph_stats.misses,
+           glyph_stats.n_written);
+}
+
 int main(int argc, char **argv) {
     sdl_ren = NULL;
 
@@ -195,21 +490,39 @@ int main(int argc, char **argv) {
 
     TIME_ON(init_font) {
         init_font();
+        font_shared_atlas = options.shared_atlas;
+        font_atlas_budget = options.glyph_budget_mb * 1024 * 1024;
+        if (options.glyph_cache) {
+            glyph_cache_init(options.glyph_cache_dir, ft_lib);
+        }
     } TIME_OFF(init_font);
 
+    update_raster_scale(DEFAULT_RES_W, DEFAULT_RES_H);
+
     TIME_ON(build_presentation) {
         pres = build_presentation(pres_path, sdl_ren);
     } TIME_OFF(build_presentation);
 
+    print_glyph_cache_stats("startup");
+
     if (options.to_pdf) {
         pres.speed = INFINITY;
         do_pdf_export();
+        glyph_cache_save();
+        return 0;
+    }
+
+    if (options.stats) { print_font_atlas_stats(); }
+
+    if (options.bench_glyphs) {
+        bench_glyphs();
         return 0;
     }
 
     if (!options.check) {
         update_window_resolution(&pres);
         SDL_SetWindowSize(sdl_win, pres.w, pres.h);
+        update_raster_scale(pres.w, pres.h);
     }
 
     if (options.check) { return 0; }
@@ -217,6 +530,22 @@ int main(int argc, char **argv) {
     register_hup_handler();
     do_present();
     fini_video();
+    glyph_cache_save();
+
+    print_glyph_cache_stats("session");
+
+    if (options.stats && session_idle_wall_us) {
+        printf("[stats] idle CPU over the session: %.1f%% (%s loop)\n",
+               100.0 * session_idle_cpu_us / session_idle_wall_us,
+               options.wait_events ? "event driven" : "polling");
+    }
+
+    if (options.prefetch) {
+        printf("[prefetch] prepared %u images and %u slides ahead of time, saving %u slow frames\n",
+               prefetch.n_images,
+               prefetch.n_slides,
+               prefetch.frames_saved);
+    }
 
     return 0;
 }
@@ -250,7 +579,7 @@ static void draw_grid(void) {
         r.y = 0;
         r.h = pres.h;
 
-        SDL_RenderFillRect(sdl_ren, &r);
+        batch_fill_rect(sdl_ren, &r);
     }
 
     r.h = 4;
@@ -261,16 +590,24 @@ static void draw_grid(void) {
         r.y = y;
         r.w = pres.w;
 
-        SDL_RenderFillRect(sdl_ren, &r);
+        batch_fill_rect(sdl_ren, &r);
     }
 }
 
+static int minimap_n_slides(void) {
+    return (-(pres.save_points[pres.n_points - 1]) + pres.h) / pres.h;
+}
+
+static int minimap_scale(void) {
+    return MAX(minimap_n_slides(), 8);
+}
+
 static void draw_minimap(void) {
     int save_point  = pres.point;
     int save_view_x = pres.view_x;
     int save_view_y = pres.view_y;
-    int n_slides    = (-(pres.save_points[pres.n_points - 1]) + pres.h) / pres.h;
-    int scale       = MAX(n_slides, 8);
+    int n_slides    = minimap_n_slides();
+    int scale       = minimap_scale();
 
     int new_w = scale * pres.w;
     int new_h = scale * pres.h;
@@ -286,15 +623,19 @@ static void draw_minimap(void) {
                            pres.g > 127 ? pres.g - 20 : pres.g + 20,
                            pres.b > 127 ? pres.b - 20 : pres.b + 20,
                            200);
-    SDL_RenderFillRect(sdl_ren, &r);
+    batch_fill_rect(sdl_ren, &r);
 
-    pres.view_x = pres.view_y = 0;
-    int save_max_view_slides = pres.max_view_slides;
-    pres.max_view_slides = n_slides;
+    if (minimap_thumbnails) {
+        draw_thumbnails(&pres);
+    } else {
+        pres.view_x = pres.view_y = 0;
+        int save_max_view_slides = pres.max_view_slides;
+        pres.max_view_slides = n_slides;
 
-    draw_presentation_no_clear(&pres);
+        draw_presentation_no_clear(&pres);
 
-    pres.max_view_slides = save_max_view_slides;
+        pres.max_view_slides = save_max_view_slides;
+    }
 
     pres.point  = save_point;
     pres.view_x = save_view_x;
@@ -320,7 +661,7 @@ static void draw_minimap(void) {
                                        255 - pres.g,
                                        255 - pres.b,
                                        100);
-                SDL_RenderFillRect(sdl_ren, &r);
+                batch_fill_rect(sdl_ren, &r);
 
                 minimap_point = p;
                 goto point_selected;
@@ -337,6 +678,7 @@ point_selected:;
 void do_present(void) {
     int             quit;
     u32             frame_start_ms, frame_elapsed_ms;
+    u64             frame_start_us, frame_start_cpu_us;
     u64             frame;
     float           last_frame_time;
     int             save_point;
@@ -344,14 +686,19 @@ void do_present(void) {
     int             sleep_ms;
     int             winch;
     int             was_animating;
+    int             animating;
     int             old_show_grid;
-
-    quit          = 0;
-    frame         = 0;
-    save_point    = 0;
-    winch         = 0;
-    was_animating = 0;
-    old_show_grid = show_grid;
+    int             n_events;
+    int             timeout_ms;
+
+    quit               = 0;
+    frame              = 0;
+    frame_start_us     = 0;
+    frame_start_cpu_us = 0;
+    save_point         = 0;
+    winch              = 0;
+    was_animating      = 0;
+    old_show_grid      = show_grid;
 
     /*
      * Draw the presentation once first before waiting for input.
@@ -359,7 +706,7 @@ void do_present(void) {
      * create our window and draw before that delay.
      */
 
-    draw_presentation(&pres);
+    draw_presentation_cached(&pres);
     SDL_RenderPresent(sdl_ren);
     SDL_ShowWindow(sdl_win);
     printf("time to first draw: %ums\n", SDL_GetTicks() - start_ms);
@@ -367,20 +714,45 @@ void do_present(void) {
     while (!quit) {
         frame_start_ms = SDL_GetTicks();
 
+        if (options.stats) {
+            frame_start_us     = gettime_ns() / 1000;
+            frame_start_cpu_us = cpu_time_us();
+        }
+
+        batch_reset_draw_calls();
+        pres.n_visited = pres.n_drawn = pres.n_prefetch_used = 0;
+
         if (reloading) {
             save_point = pres.point;
             reload_pres(&pres, pres_path);
+            prefetch.point = -1;
         }
 
-        handle_input(&quit, &reloading, &show_grid, &show_minimap, &winch);
+        n_events = handle_input(&quit, &reloading, &show_grid, &show_minimap, &winch);
 
-        should_draw   =    was_animating
+        /*
+         * When waiting for events, nothing changes without one, so there's
+         * no need for the periodic redraw. Any event redraws since it may
+         * have changed something that isn't tracked here (e.g. the mouse
+         * hovering over the minimap).
+         */
+        animating     =    was_animating
                         || pres.is_animating
-                        || pres.movement_started
+                        || pres.movement_started;
+        should_draw   =    animating
                         || reloading
                         || winch
                         || show_grid != old_show_grid
-                        || (frame % NON_ANIM_DRAW_INTERVAL == 0);
+                        || (options.wait_events
+                                ? n_events > 0
+                                : frame % NON_ANIM_DRAW_INTERVAL == 0);
+        if (winch) {
+            prefetch.point = -1;
+            if (update_raster_scale(pres.w, pres.h) && options.stats) {
+                print_font_atlas_stats();
+            }
+        }
+
         winch         =    0;
 
         SDL_ShowCursor(show_cursor || show_grid || show_minimap ? SDL_ENABLE : SDL_DISABLE);
@@ -395,8 +767,10 @@ void do_present(void) {
                 } else {
                     pres_restore_point(&pres, minimap_save_point);
                 }
+
+                minimap_thumbnails = update_thumbnails(&pres, minimap_scale());
             }
-            draw_presentation(&pres);
+            draw_presentation_cached(&pres);
         }
 
         update_presentation(&pres);
@@ -425,30 +799,76 @@ void do_present(void) {
 
 /*             SDL_RenderFlush(sdl_ren); */
             SDL_RenderPresent(sdl_ren);
+            font_end_frame();
 
             SDL_Delay(0);
+
+            /* Everything that this frame drew first was ready in advance. */
+            if (pres.n_prefetch_used) {
+                prefetch.frames_saved += 1;
+            }
+
+            if (options.stats) { stats_frame(); }
         }
 
+        if (options.stats) { stats_report(); }
+
         frame_elapsed_ms  = SDL_GetTicks() - frame_start_ms;
         frame            += 1;
 
         last_frame_time   = (float)frame_elapsed_ms;
 
+        if (options.prefetch && !should_draw && !was_animating) {
+            prefetch_neighbours(frame_start_ms + FPS_CAP_MS);
+            frame_elapsed_ms = SDL_GetTicks() - frame_start_ms;
+        }
+
         if (!should_draw && !was_animating) {
-            sleep_ms = FPS_CAP_MS - frame_elapsed_ms;
-            if (sleep_ms > 0) {
-                SDL_Delay(sleep_ms);
+            if (options.wait_events) {
+                /*
+                 * SIGHUP doesn't wake SDL up, so the wait is bounded to
+                 * notice reload requests. Unfinished prefetching keeps
+                 * the loop going.
+                 */
+                timeout_ms = EVENT_WAIT_TIMEOUT_MS;
+                if (options.prefetch && !prefetch.done) {
+                    timeout_ms = 0;
+                }
+
+                if (!reloading) {
+                    SDL_WaitEventTimeout(NULL, timeout_ms);
+                }
+            } else {
+                sleep_ms = FPS_CAP_MS - frame_elapsed_ms;
+                if (sleep_ms > 0) {
+                    SDL_Delay(sleep_ms);
+                }
             }
         }
+
+        /*
+         * Everything outside of animations counts as idle, including
+         * the polling loop's periodic redraws, so that both loops are
+         * measured the same way.
+         */
+        if (options.stats && !animating) {
+            stats_idle(gettime_ns() / 1000 - frame_start_us,
+                       cpu_time_us() - frame_start_cpu_us);
+        }
     }
 
 }
 
-void handle_input(int *quit, int *reloading, int *show_grid, int *show_minimap, int *winch) {
+int handle_input(int *quit, int *reloading, int *show_grid, int *show_minimap, int *winch) {
     SDL_Event    e;
     const Uint8 *key_state;
+    int          n_events;
+
+    n_events = 0;
 
     while (SDL_PollEvent(&e) != 0) {
+        n_events += 1;
+
         if (e.type == SDL_QUIT) {
             *quit = 1;
         } else if (e.type == SDL_KEYUP) {
@@ -504,8 +924,14 @@ void handle_input(int *quit, int *reloading, int *show_grid, int *show_minimap,
             minimap_point = -1;
         } else if (e.type == SDL_WINDOWEVENT && e.window.event != SDL_WINDOWEVENT_MOVED) {
             *winch = 1;
+        } else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+            slide_cache_invalidate();
+            free_thumbnails();
+            *winch = 1;
         }
     }
+
+    return n_events;
 }
 
 int init_video(void) {
@@ -526,6 +952,9 @@ int init_video(void) {
         render_flags |= SDL_RENDERER_TARGETTEXTURE;
     }
 
+    if (options.slide_cache) {
+        render_flags |= SDL_RENDERER_TARGETTEXTURE;
+    }
 
     TIME_ON(sdl_init_video) {
         if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
@@ -559,6 +988,10 @@ int init_video(void) {
     SDL_SetRenderDrawBlendMode(sdl_ren, SDL_BLENDMODE_BLEND);
     SDL_RenderSetLogicalSize(sdl_ren, DEFAULT_RES_W, DEFAULT_RES_H);
 
+    if (options.slide_cache) {
+        options.slide_cache = slide_cache_init(sdl_ren, options.slide_cache_mb * 1024 * 1024);
+    }
+
     return 1;
 }
 
@@ -569,12 +1002,10 @@ void fini_video(void) {
 }
 
 
-void draw_simple_string_at(int x, int y, const char *str, font_cache_t *font) {
+void draw_simple_string_at(int x, int y, const char *str, font_cache_t *font, u32 r, u32 g, u32 b) {
     int            len;
     int            i;
     font_entry_t  *entry;
-    SDL_Rect       srect,
-                   drect;
     char_code_t    code;
     int            n_bytes;
 
@@ -586,23 +1017,15 @@ void draw_simple_string_at(int x, int y, const char *str, font_cache_t *font) {
         code  = get_char_code(str + i, &n_bytes);
         entry = get_glyph(font, code, sdl_ren);
 
-        srect.x = entry->x;
-        srect.y = entry->y;
-        srect.w = entry->w;
-        srect.h = entry->h;
-
-        drect.x = x + entry->adjust_x;
-        drect.y = y - entry->adjust_y;
-        drect.w = entry->w;
-        drect.h = entry->h;
-
-        SDL_RenderCopy(sdl_ren, entry->texture, &srect, &drect);
+        batch_glyph(sdl_ren, entry, x, y, r, g, b);
 
         x += entry->pen_advance_x;
         y += entry->pen_advance_y;
 
         i += n_bytes;
     }
+
+    batch_flush(sdl_ren);
 }
 
 void draw_time(float time) {
@@ -615,6 +1038,5 @@ void draw_time(float time) {
     sprintf(buff, "%.1fms", time);
 
     font = get_or_load_font("fonts/luximr.ttf", size, sdl_ren);
-    set_font_color(font, 255, 0, 255);
-    draw_simple_string_at(0, pres.h - size, buff, font);
+    draw_simple_string_at(0, pres.h - size, buff, font, 255, 0, 255);
 }
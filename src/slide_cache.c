@@ -0,0 +1,281 @@
+#include "slide_cache.h"
+#include "batch.h"
+
+#include <math.h>
+
+static int     enabled;
+static array_t entries;
+static u64     budget;
+static u64     bytes;
+static u64     tick;
+static int     tex_w, tex_h;
+static u32     hits, misses, evictions;
+
+int slide_cache_init(SDL_Renderer *sdl_ren, u64 budget_bytes) {
+    if (!SDL_RenderTargetSupported(sdl_ren)) {
+        printf("slide: the renderer doesn't support render targets, slide cache disabled\n");
+        return 0;
+    }
+
+    entries = array_make(slide_cache_entry_t);
+    budget  = budget_bytes;
+    enabled = 1;
+
+    return 1;
+}
+
+static u64 texture_bytes(void) {
+    return (u64)tex_w * (u64)tex_h * 4;
+}
+
+void slide_cache_invalidate(void) {
+    slide_cache_entry_t *entry;
+
+    if (!enabled) { return; }
+
+    array_traverse(entries, entry) {
+        SDL_DestroyTexture(entry->texture);
+    }
+
+    array_clear(entries);
+    bytes = 0;
+}
+
+/*
+ * Textures used in the current frame are never evicted, so the budget
+ * can be exceeded by the (at most two) slides that are on screen.
+ */
+static void evict(u64 needed) {
+    slide_cache_entry_t *entry;
+    int                  oldest;
+    int                  i;
+
+    while (bytes + needed > budget) {
+        oldest = -1;
+
+        for (i = 0; i < array_len(entries); i += 1) {
+            entry = array_item(entries, i);
+
+            if (entry->last_used == tick) { continue; }
+
+            if (oldest < 0
+            ||  entry->last_used < ((slide_cache_entry_t*)array_item(entries, oldest))->last_used) {
+                oldest = i;
+            }
+        }
+
+        if (oldest < 0) { break; }
+
+        entry = array_item(entries, oldest);
+        SDL_DestroyTexture(entry->texture);
+        array_delete(entries, oldest);
+
+        bytes     -= texture_bytes();
+        evictions += 1;
+    }
+}
+
+/*
+ * Slides are rendered at the size they end up on screen so that
+ * drawing them is a 1:1 copy.
+ */
+static void update_texture_size(pres_t *pres) {
+    int   out_w, out_h;
+    float scale;
+    int   w, h;
+
+    SDL_GetRendererOutputSize(pres->sdl_ren, &out_w, &out_h);
+
+    scale = MIN((float)out_w / pres->w, (float)out_h / pres->h);
+    w     = MAX(1, (int)ceilf(scale * pres->w));
+    h     = MAX(1, (int)ceilf(scale * pres->h));
+
+    if (w != tex_w || h != tex_h) {
+        if (array_len(entries)) {
+            printf("[slide cache] output size is now %dx%d, dropping %d slides\n",
+                   w, h, array_len(entries));
+        }
+
+        slide_cache_invalidate();
+        tex_w = w;
+        tex_h = h;
+    }
+}
+
+static SDL_Texture *render_slide(pres_t *pres, int slide) {
+    SDL_Texture *texture;
+    int          log_w, log_h;
+
+    texture = SDL_CreateTexture(pres->sdl_ren,
+                                SDL_PIXELFORMAT_RGBA8888,
+                                SDL_TEXTUREACCESS_TARGET,
+                                tex_w, tex_h);
+
+    if (texture == NULL) { return NULL; }
+
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+
+    SDL_RenderGetLogicalSize(pres->sdl_ren, &log_w, &log_h);
+
+    SDL_SetRenderTarget(pres->sdl_ren, texture);
+    SDL_RenderSetLogicalSize(pres->sdl_ren, pres->w, pres->h);
+
+    draw_presentation_slide(pres, slide, 1);
+
+    SDL_SetRenderTarget(pres->sdl_ren, NULL);
+    SDL_RenderSetLogicalSize(pres->sdl_ren, log_w, log_h);
+
+    return texture;
+}
+
+static slide_cache_entry_t *lookup(u64 hash) {
+    slide_cache_entry_t *entry;
+
+    array_traverse(entries, entry) {
+        if (entry->hash == hash) { return entry; }
+    }
+
+    return NULL;
+}
+
+static SDL_Texture *add_slide(pres_t *pres, int slide, u64 hash, int prefetched) {
+    slide_cache_entry_t new_entry;
+
+    new_entry.hash       = hash;
+    new_entry.texture    = render_slide(pres, slide);
+    new_entry.last_used  = tick;
+    new_entry.prefetched = prefetched;
+
+    if (new_entry.texture == NULL) { return NULL; }
+
+    array_push(entries, new_entry);
+    bytes += texture_bytes();
+
+    return new_entry.texture;
+}
+
+static SDL_Texture *get_slide(pres_t *pres, int slide) {
+    u64                  hash;
+    slide_cache_entry_t *entry;
+
+    hash  = pres_slide_hash(pres, slide);
+    entry = lookup(hash);
+
+    if (entry != NULL) {
+        if (entry->prefetched) {
+            entry->prefetched      = 0;
+            pres->n_prefetch_used += 1;
+        }
+
+        entry->last_used  = tick;
+        hits             += 1;
+
+        return entry->texture;
+    }
+
+    misses += 1;
+
+    evict(texture_bytes());
+
+    return add_slide(pres, slide, hash, 0);
+}
+
+/* The view at top covers parts of at most two slides. */
+static int visible_slides(pres_t *pres, int top, int slides[2]) {
+    int s;
+    int i;
+    int n;
+
+    s = top >= 0 ? top / (int)pres->h : -((-top + (int)pres->h - 1) / (int)pres->h);
+    n = 0;
+
+    for (i = s; i <= s + 1; i += 1) {
+        if (i < 0 || i >= pres_n_slides(pres))      { continue; }
+        if (i * (int)pres->h >= top + (int)pres->h) { continue; }
+
+        slides[n]  = i;
+        n         += 1;
+    }
+
+    return n;
+}
+
+void draw_presentation_cached(pres_t *pres) {
+    SDL_Texture *textures[2];
+    int          slides[2];
+    int          n;
+    int          i;
+    SDL_Rect     r;
+
+    if (!enabled) {
+        draw_presentation(pres);
+        return;
+    }
+
+    tick += 1;
+
+    update_texture_size(pres);
+
+    n = visible_slides(pres, -pres->view_y, slides);
+
+    for (i = 0; i < n; i += 1) {
+        textures[i] = get_slide(pres, slides[i]);
+
+        if (textures[i] == NULL) {
+            draw_presentation(pres);
+            return;
+        }
+    }
+
+    pres_clear_and_draw_bg(pres);
+
+    for (i = 0; i < n; i += 1) {
+        r.x = pres->view_x;
+        r.y = pres->view_y + slides[i] * (int)pres->h;
+        r.w = pres->w;
+        r.h = pres->h;
+
+        batch_copy(pres->sdl_ren, textures[i], NULL, &r);
+    }
+}
+
+/*
+ * Renders at most one of the slides visible at point that isn't cached
+ * yet. Unlike a draw, a prefetch never goes over the budget.
+ * Returns 1 if a slide was rendered.
+ */
+int slide_cache_prefetch(pres_t *pres, int point) {
+    int slides[2];
+    int n;
+    int i;
+    u64 hash;
+
+    if (!enabled || point < 0 || point >= pres->n_points) { return 0; }
+
+    update_texture_size(pres);
+
+    n = visible_slides(pres, -pres->save_points[point], slides);
+
+    for (i = 0; i < n; i += 1) {
+        hash = pres_slide_hash(pres, slides[i]);
+
+        if (lookup(hash) != NULL) { continue; }
+
+        evict(texture_bytes());
+
+        if (bytes + texture_bytes() > budget) { return 0; }
+
+        return add_slide(pres, slides[i], hash, 1) != NULL;
+    }
+
+    return 0;
+}
+
+void get_slide_cache_stats(slide_cache_stats_t *stats) {
+    stats->n_slides  = enabled ? array_len(entries) : 0;
+    stats->bytes     = bytes;
+    stats->budget    = budget;
+    stats->hits      = hits;
+    stats->misses    = misses;
+    stats->evictions = evictions;
+}
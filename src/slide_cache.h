@@ -0,0 +1,42 @@
+#ifndef __SLIDE_CACHE_H__
+#define __SLIDE_CACHE_H__
+
+#include "internal.h"
+#include "array.h"
+#include "presentation.h"
+
+/*
+ * Slide cache.
+ *
+ * Each slide-sized band of the deck is rendered once into a target
+ * texture at the renderer's output resolution and drawn from there,
+ * so a frame costs one or two textured quads no matter how much text
+ * is on screen. Textures are keyed by the slide's content hash, which
+ * means a reload only re-renders the slides that actually changed.
+ * The least recently used textures are dropped when the memory budget
+ * is exceeded. A change of output resolution drops everything.
+ */
+
+typedef struct {
+    u64          hash;
+    SDL_Texture *texture;
+    u64          last_used;
+    int          prefetched; /* rendered ahead of its first draw */
+} slide_cache_entry_t;
+
+typedef struct {
+    int n_slides;
+    u64 bytes;
+    u64 budget;
+    u32 hits;
+    u32 misses;
+    u32 evictions;
+} slide_cache_stats_t;
+
+int  slide_cache_init(SDL_Renderer *sdl_ren, u64 budget);
+void slide_cache_invalidate(void);
+void draw_presentation_cached(pres_t *pres);
+int  slide_cache_prefetch(pres_t *pres, int point);
+void get_slide_cache_stats(slide_cache_stats_t *stats);
+
+#endif
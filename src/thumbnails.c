@@ -0,0 +1,151 @@
+#include "thumbnails.h"
+#include "batch.h"
+
+#include <math.h>
+
+static array_t       thumbnails;
+static int           supported = -1;
+static SDL_BlendMode blend_mode;
+
+static int init(SDL_Renderer *sdl_ren) {
+    if (supported < 0) {
+        supported  = SDL_RenderTargetSupported(sdl_ren);
+        thumbnails = array_make(thumbnail_t);
+        blend_mode = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                                                SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    }
+
+    return supported;
+}
+
+static void free_thumbnail(thumbnail_t *thumb) {
+    if (thumb->texture != NULL) {
+        SDL_DestroyTexture(thumb->texture);
+    }
+
+    memset(thumb, 0, sizeof(*thumb));
+}
+
+static int render_thumbnail(pres_t *pres, int slide, thumbnail_t *thumb, int w, int h) {
+    int log_w, log_h;
+
+    if (thumb->texture == NULL || thumb->w != w || thumb->h != h) {
+        free_thumbnail(thumb);
+
+        thumb->texture = SDL_CreateTexture(pres->sdl_ren,
+                                           SDL_PIXELFORMAT_RGBA8888,
+                                           SDL_TEXTUREACCESS_TARGET,
+                                           w, h);
+
+        if (thumb->texture == NULL) { return 0; }
+
+        /*
+         * Not every renderer supports custom blend modes. Plain blending
+         * only makes antialiased edges come out a little darker.
+         */
+        if (SDL_SetTextureBlendMode(thumb->texture, blend_mode) != 0) {
+            SDL_SetTextureBlendMode(thumb->texture, SDL_BLENDMODE_BLEND);
+        }
+
+        thumb->w = w;
+        thumb->h = h;
+    }
+
+    SDL_RenderGetLogicalSize(pres->sdl_ren, &log_w, &log_h);
+
+    SDL_SetRenderTarget(pres->sdl_ren, thumb->texture);
+    SDL_RenderSetLogicalSize(pres->sdl_ren, pres->w, pres->h);
+
+    SDL_SetRenderDrawColor(pres->sdl_ren, 0, 0, 0, 0);
+    SDL_RenderClear(pres->sdl_ren);
+
+    draw_presentation_slide(pres, slide, 0);
+
+    SDL_SetRenderTarget(pres->sdl_ren, NULL);
+    SDL_RenderSetLogicalSize(pres->sdl_ren, log_w, log_h);
+
+    thumb->hash = pres_slide_hash(pres, slide);
+
+    return 1;
+}
+
+/*
+ * Brings the thumbnails up to date for a minimap that shows the deck
+ * at 1/scale of its size. This should happen before anything else is
+ * drawn in the frame.
+ * Returns 0 if thumbnails can't be used with this renderer.
+ */
+int update_thumbnails(pres_t *pres, int scale) {
+    int          out_w, out_h;
+    float        f;
+    int          w, h;
+    int          n_slides;
+    int          s;
+    thumbnail_t *thumb;
+    thumbnail_t  new_thumb;
+
+    if (!init(pres->sdl_ren)) { return 0; }
+
+    SDL_GetRendererOutputSize(pres->sdl_ren, &out_w, &out_h);
+
+    f = MIN((float)out_w / (scale * pres->w), (float)out_h / (scale * pres->h));
+    w = MAX(1, (int)ceilf(f * pres->w));
+    h = MAX(1, (int)ceilf(f * pres->h));
+
+    n_slides = pres_n_slides(pres);
+
+    while (array_len(thumbnails) > n_slides) {
+        free_thumbnail(array_last(thumbnails));
+        array_pop(thumbnails);
+    }
+
+    memset(&new_thumb, 0, sizeof(new_thumb));
+
+    while (array_len(thumbnails) < n_slides) {
+        array_push(thumbnails, new_thumb);
+    }
+
+    for (s = 0; s < n_slides; s += 1) {
+        thumb = array_item(thumbnails, s);
+
+        if (thumb->texture == NULL
+        ||  thumb->w != w
+        ||  thumb->h != h
+        ||  thumb->hash != pres_slide_hash(pres, s)) {
+
+            if (!render_thumbnail(pres, s, thumb, w, h)) { return 0; }
+        }
+    }
+
+    return 1;
+}
+
+/* Draws the whole deck from its top at the current logical size. */
+void draw_thumbnails(pres_t *pres) {
+    thumbnail_t *thumb;
+    int          s;
+    SDL_Rect     r;
+
+    for (s = 0; s < array_len(thumbnails); s += 1) {
+        thumb = array_item(thumbnails, s);
+
+        r.x = 0;
+        r.y = s * (int)pres->h;
+        r.w = pres->w;
+        r.h = pres->h;
+
+        batch_copy(pres->sdl_ren, thumb->texture, NULL, &r);
+    }
+}
+
+void free_thumbnails(void) {
+    thumbnail_t *thumb;
+
+    if (supported < 0) { return; }
+
+    array_traverse(thumbnails, thumb) {
+        free_thumbnail(thumb);
+    }
+
+    array_clear(thumbnails);
+}
@@ -0,0 +1,32 @@
+#ifndef __THUMBNAILS_H__
+#define __THUMBNAILS_H__
+
+#include "internal.h"
+#include "array.h"
+#include "presentation.h"
+
+/*
+ * Minimap thumbnails.
+ *
+ * Every slide of the deck is rendered once into a small texture at the
+ * size it has in the minimap, so drawing the minimap costs one quad
+ * per slide. A thumbnail is re-rendered when its slide's content hash
+ * changes (e.g. after a reload) or when the minimap's scale changes.
+ *
+ * Thumbnails have a transparent background and are drawn over the
+ * minimap's backdrop, just like the deck used to be drawn directly.
+ * They hold premultiplied alpha, since that's what blending into a
+ * cleared target produces.
+ */
+
+typedef struct {
+    u64          hash;
+    SDL_Texture *texture;
+    int          w, h;
+} thumbnail_t;
+
+int  update_thumbnails(pres_t *pres, int scale);
+void draw_thumbnails(pres_t *pres);
+void free_thumbnails(void);
+
+#endif